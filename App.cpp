@@ -8,6 +8,13 @@
 #include <imgui_impl_sdlrenderer2.h>
 
 
+//playback speed presets for the menu and the [ ] keys
+static const float kSpeedPresets[] = {0.25f, 0.5f, 0.75f, 1.0f, 1.25f, 1.5f, 2.0f, 3.0f, 4.0f};
+static const int kSpeedPresetCount = sizeof(kSpeedPresets) / sizeof(kSpeedPresets[0]);
+// Read-ahead distances offered in the I/O menu (0: off)
+static const int kPrefetchPresetsMB[] = {0, 4, 16, 64};
+
+
 
 
 
@@ -17,6 +24,9 @@ App::App(){
 }
 
 App::~App(){
+    //stop playback threads and free the texture while the renderer still exists
+    videoPlayer.cleanup();
+
     ImGui_ImplSDLRenderer2_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
@@ -45,11 +55,16 @@ bool App::init(){
         return false;
     }
 
-    renderer = SDL_CreateRenderer(window,-1, SDL_RENDERER_ACCELERATED  /*can use this to do software rendering or hardware acceleration etc */);
+    renderer = SDL_CreateRenderer(window,-1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC /*present on vblank: no tearing, no judder*/);
+    if (!renderer) {
+        //no vsync renderer available: the frame pacer times the presents itself
+        renderer = SDL_CreateRenderer(window,-1, SDL_RENDERER_ACCELERATED  /*can use this to do software rendering or hardware acceleration etc */);
+    }
     if (!renderer) {
         std::cerr << "Renderer Error: " << SDL_GetError() << std::endl;
         return false;
     }
+    framePacer.init(window, renderer);
 
     //Dear Imgui context 
     IMGUI_CHECKVERSION();
@@ -66,22 +81,43 @@ bool App::init(){
 
 //Main loop 
 void App::run(){
+    int settleFrames = kUiSettleFrames; //draw the first frames unconditionally
     while (isRunning)
     {
-        handelEvents();
+        //sleep until input arrives or the player has something due; idle (paused, no input) sleeps long
+        int waitMs = kIdleWaitMs;
+        bool playerBusy = videoPlayer.needsRefresh();
+        if (settleFrames > 0) {
+            waitMs = kPollMs;
+        } else if (playerBusy) {
+            waitMs = kPollMs;
+            double untilNextFrame = videoPlayer.getTimeUntilNextFrame();
+            if (untilNextFrame >= 0.0 && untilNextFrame * 1000.0 < waitMs) {
+                waitMs = static_cast<int>(untilNextFrame * 1000.0);
+            }
+        }
+        if (handelEvents(waitMs)) settleFrames = kUiSettleFrames;
         update();
-        render();
-        SDL_Delay(1000/60); //60 fps  
-        //need to research about this ?? can add feature to decude frames to run the video 
 
+        //nothing changed: keep the last presented frame on screen
+        if (settleFrames == 0 && !playerBusy && !videoPlayer.needsRefresh()) {
+            idleWakeups++;
+            continue;
+        }
+        render();
+        framesRendered++;
+        if (settleFrames > 0) settleFrames--;
     }
     
 }
 
-//Handel Sdl events 
-void App::handelEvents(){
+//Handel Sdl events (blocks for up to waitMs until the first one arrives)
+bool App::handelEvents(int waitMs){
     SDL_Event event;
-    while (SDL_PollEvent(&event)){
+    bool handled = false;
+    bool got = waitMs > 0 ? SDL_WaitEventTimeout(&event, waitMs) : SDL_PollEvent(&event);
+    for (; got; got = SDL_PollEvent(&event)){
+        handled = true;
         ImGui_ImplSDL2_ProcessEvent(&event); //importatnt to handel the navigation gui
 
 
@@ -89,6 +125,11 @@ void App::handelEvents(){
         {
             isRunning = false;
         }
+
+        //the window may now be on a display with another refresh rate
+        if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_MOVED) {
+            framePacer.updateRefresh(window);
+        }
         
         if(event.type == SDL_KEYDOWN){
             if(event.key.keysym.sym == SDLK_SPACE){
@@ -116,6 +157,23 @@ void App::handelEvents(){
             if(event.key.keysym.sym == SDLK_RIGHT){
                 videoPlayer.seek(5.0f); //forward 5 seconds
             }
+            //frame stepping (pauses playback)
+            if(event.key.keysym.sym == SDLK_PERIOD){
+                videoPlayer.stepForward();
+            }
+            if(event.key.keysym.sym == SDLK_COMMA){
+                videoPlayer.stepBackward();
+            }
+            if(event.key.keysym.sym == SDLK_r){
+                videoPlayer.setReverse(!videoPlayer.isReverse()); //toggle reverse playback
+            }
+            //playback speed
+            if(event.key.keysym.sym == SDLK_LEFTBRACKET){
+                changeSpeed(-1); //slower
+            }
+            if(event.key.keysym.sym == SDLK_RIGHTBRACKET){
+                changeSpeed(1); //faster
+            }
             //volume control
             if(event.key.keysym.sym == SDLK_DOWN){
                 videoPlayer.changeVolume(-0.1f); //decrease volume
@@ -126,10 +184,21 @@ void App::handelEvents(){
         
         }
     }
-    
+    return handled;
 }
 
 
+//step to the next slower/faster speed preset
+void App::changeSpeed(int steps){
+    float current = videoPlayer.getPlaybackRate();
+    int index = 0;
+    while (index < kSpeedPresetCount - 1 && kSpeedPresets[index] < current) index++;
+    index += steps;
+    if (index < 0) index = 0;
+    if (index >= kSpeedPresetCount) index = kSpeedPresetCount - 1;
+    videoPlayer.setPlaybackRate(kSpeedPresets[index]);
+}
+
 //Update LOgc (placeHolder)
 
 void App::update(){
@@ -138,6 +207,9 @@ void App::update(){
 
 void App::render(){
     
+//the vsync this frame will go out on (ImGui and the texture upload are counted as render cost)
+double presentLead = framePacer.beginFrame();
+
 //importat values
 float currentTime = videoPlayer.getcurrentTime();
 float duration = videoPlayer.getDuration();
@@ -189,6 +261,118 @@ float duration = videoPlayer.getDuration();
         videoPlayer.changeVolume(0.1f);
     }
 
+    //playback speed
+    char speedText[32];
+    snprintf(speedText, sizeof(speedText), "%gx###Speed", videoPlayer.getPlaybackRate());
+    if (ImGui::BeginMenu(speedText)) {
+        for (int i = 0; i < kSpeedPresetCount; i++) {
+            char label[16];
+            snprintf(label, sizeof(label), "%gx", kSpeedPresets[i]);
+            if (ImGui::MenuItem(label, nullptr, videoPlayer.getPlaybackRate() == kSpeedPresets[i])) {
+                videoPlayer.setPlaybackRate(kSpeedPresets[i]);
+            }
+        }
+        ImGui::EndMenu();
+    }
+
+    //resize filter for scale-on-decode (fast to sharp)
+    if (ImGui::BeginMenu("Scaler")) {
+        for (ScaleAlgorithm algorithm : {ScaleAlgorithm::FastBilinear, ScaleAlgorithm::Bilinear,
+                                         ScaleAlgorithm::Bicubic, ScaleAlgorithm::Lanczos, ScaleAlgorithm::Area}) {
+            if (ImGui::MenuItem(scaleAlgorithmName(algorithm), nullptr, videoPlayer.getScaleAlgorithm() == algorithm)) {
+                videoPlayer.setScaleAlgorithm(algorithm);
+            }
+        }
+        ImGui::Separator();
+        // Decode at a fraction of the size when the window is small (previews), see chooseLowres
+        bool autoLowres = videoPlayer.getOptions().lowres < 0;
+        if (ImGui::MenuItem("Low-res decode for small windows", nullptr, autoLowres)) {
+            videoPlayer.setLowres(autoLowres ? 0 : -1);
+        }
+        ImGui::TextDisabled("Takes effect on the next open");
+        ImGui::EndMenu();
+    }
+
+    //how files are read, applies to the next file opened
+    if (ImGui::BeginMenu("I/O")) {
+        InputOptions input = videoPlayer.getOptions().input;
+        if (ImGui::MenuItem("Memory-mapped reads", nullptr, input.mmapIO)) {
+            input.mmapIO = !input.mmapIO;
+            videoPlayer.setInputOptions(input);
+        }
+        if (ImGui::MenuItem("Cache stream info", nullptr, input.streamInfoCache)) {
+            input.streamInfoCache = !input.streamInfoCache;
+            videoPlayer.setInputOptions(input);
+        }
+        // Only used when the file is not memory-mapped
+        if (ImGui::BeginMenu("Read-ahead", !input.mmapIO)) {
+            for (int megabytes : kPrefetchPresetsMB) {
+                char label[16];
+                if (megabytes == 0) snprintf(label, sizeof(label), "Off");
+                else snprintf(label, sizeof(label), "%d MB", megabytes);
+                size_t bytes = static_cast<size_t>(megabytes) * 1024 * 1024;
+                if (ImGui::MenuItem(label, nullptr, input.prefetchBytes == bytes)) {
+                    input.prefetchBytes = bytes;
+                    videoPlayer.setInputOptions(input);
+                }
+            }
+            ImGui::EndMenu();
+        }
+        ImGui::TextDisabled("Takes effect on the next open");
+        ImGui::EndMenu();
+    }
+
+    //playback / sync statistics
+    if (ImGui::BeginMenu("Stats")) {
+        VideoPlayer::PlaybackStats stats = videoPlayer.getStats();
+        ImGui::Text("Clock: %s", stats.audioMaster ? "audio" : "system");
+        ImGui::Text("Open: %.1f ms (stream info: %s), first frame after %.1f ms",
+            stats.openMs, stats.streamInfo, stats.firstFrameMs);
+        ImGui::Text("Presented: %d  Dropped: %d  Repeated: %d",
+            stats.framesPresented, stats.framesDropped, stats.framesRepeated);
+        ImGui::Text("Drift: %+.1f ms (avg %.1f ms, max %.1f ms)",
+            stats.drift * 1000.0, stats.avgDrift * 1000.0, stats.maxDrift * 1000.0);
+        ImGui::Text("Late dropped: %d  Skip level: %d (%d changes)",
+            stats.lateDropped, stats.skipLevel, stats.skipLevelChanges);
+        ImGui::Text("Decoder: %s, %d threads (%s)",
+            stats.videoCodec, stats.decoderThreads, stats.decoderThreadType);
+        ImGui::Text("Keyframe index: %s (%d keyframes)", stats.keyframeIndex, stats.keyframes);
+        ImGui::Text("Last seek: keyframe %.2f s before target, %d catch-up frames in %.1f ms",
+            stats.lastSeekKeyframeGap, stats.lastSeekCatchupFrames, stats.lastSeekCatchupMs);
+        ImGui::Text("Seeks coalesced: %d  abandoned: %d", stats.seeksCoalesced, stats.seeksAbandoned);
+        ImGui::Text("Frame cache: %d frames, %.0f MB, %d hits, %d frames replayed",
+            stats.cachedFrames, stats.cacheMB, stats.cacheHits, stats.framesFromCache);
+        ImGui::Text("Steps: %d  last step: %.1f ms", stats.steps, stats.lastStepMs);
+        ImGui::Text("Speed: %.2fx%s", stats.playbackRate, stats.rateSkip ? " (non-ref frames skipped)" : "");
+        if (stats.lowres > 0) {
+            ImGui::Text("Decode: %dx%d (lowres 1/%d)", stats.decodeWidth, stats.decodeHeight, 1 << stats.lowres);
+        } else {
+            ImGui::Text("Decode: %dx%d", stats.decodeWidth, stats.decodeHeight);
+        }
+        ImGui::Text("Upload: %dx%d (%s scaling, %d slice threads)", stats.outputWidth, stats.outputHeight,
+            stats.scaler, stats.scaleThreads);
+        if (stats.mmapIO) {
+            ImGui::Text("I/O: mmap, %llu reads (%.0f MB), %llu seeks",
+                (unsigned long long)stats.ioReads, stats.ioMB, (unsigned long long)stats.ioSeeks);
+        }
+        if (stats.prefetchReads > 0) {
+            ImGui::Text("Prefetch (%s): %llu reads, %llu stalled (%.0f ms), %llu re-targets", stats.prefetch,
+                (unsigned long long)stats.prefetchReads, (unsigned long long)stats.prefetchStalls,
+                stats.prefetchStallMs, (unsigned long long)stats.prefetchRetargets);
+        }
+        ImGui::Text("Render loop: %ld frames drawn, %ld idle wake-ups", framesRendered, idleWakeups);
+        FramePacer::Stats pacing = framePacer.getStats();
+        ImGui::Text("Present: %s @ %.2f Hz, %.2f ms apart (jitter %.2f ms, max %.1f ms), %ld missed vsyncs",
+            pacing.mode, pacing.refreshHz, pacing.avgIntervalMs, pacing.jitterMs, pacing.maxIntervalMs, pacing.missedVsyncs);
+        ImGui::Text("Cadence: %.2f vsyncs per picture (expected %.2f), %ld judder breaks",
+            pacing.avgHold, pacing.expectedHold, pacing.cadenceBreaks);
+        if (stats.reverse) {
+            ImGui::Text("Reverse: %.0f MB buffered, %d GOP re-decodes",
+                stats.reverseBufferMB, stats.reverseRedecodes);
+        }
+        ImGui::EndMenu();
+    }
+
     ImGui::EndMainMenuBar();
 }
 
@@ -215,8 +399,12 @@ float totalWidth = ImGui::GetContentRegionAvail().x;
 float timelineWidth = totalWidth * 0.75f;
 ImGui::PushItemWidth(timelineWidth);
 if (ImGui::SliderFloat("##TimeLine", &scrubberValue, 0.0f, 100.0f, "%.1f%%", ImGuiSliderFlags_AlwaysClamp)) {
-    videoPlayer.seekTo((scrubberValue / 100.0f) * duration);
+    videoPlayer.scrubTo((scrubberValue / 100.0f) * duration); // keyframe previews while dragging
 }
+if (ImGui::IsItemActivated()) videoPlayer.beginScrub();
+// Released: one accurate seek to the final position (or nothing if the slider never moved)
+if (ImGui::IsItemDeactivatedAfterEdit()) videoPlayer.endScrub((scrubberValue / 100.0f) * duration);
+else if (ImGui::IsItemDeactivated()) videoPlayer.cancelScrub();
 ImGui::PopItemWidth();
 
 
@@ -252,12 +440,17 @@ drawFileDialogUI(showFileDialog, selectedFilePath);
     
     
     //render frames from video 
+    bool newPicture = false;
     if(!loadedFilePath.empty()){
+        videoPlayer.setPresentTiming(presentLead, framePacer.getRefreshInterval());
         videoPlayer.renderFrame(renderer);  ///play's video
+        newPicture = videoPlayer.hasNewPicture();
     }
     //SDL_RenderClear(renderer);
     ImGui_ImplSDLRenderer2_RenderDrawData(ImGui::GetDrawData(),renderer);
+    framePacer.waitForPresent();
     SDL_RenderPresent(renderer);
+    framePacer.presented(newPicture, videoPlayer.getFrameInterval());
 
     
 
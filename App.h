@@ -2,6 +2,7 @@
 #include <string>
 #include <SDL2/SDL.h>
 #include "VideoPlayer.h"
+#include "FramePacer.h"
 #include <ctime>   
 
 
@@ -23,14 +24,24 @@ class App{
         std::string selectedFilePath;
         bool showFileDialog = false;
 
-        void handelEvents();
+        bool handelEvents(int waitMs); //waits up to waitMs for input, true when there was some
         void update();
         void render();
+        void changeSpeed(int steps); //move along the playback speed presets
         VideoPlayer videoPlayer;
         std::string loadedFilePath = "";
         bool startDecoding = false;
 
         bool isPaused = false;
+
+        //event-driven loop: redraw only for input, a due picture or pending player work
+        static constexpr int kUiSettleFrames = 3;    //frames drawn after input so ImGui can settle (hover, popups)
+        static constexpr int kIdleWaitMs = 250;      //longest sleep while nothing is happening
+        static constexpr int kPollMs = 1000 / 60;    //wake-up interval while playing without a known deadline
+        long framesRendered = 0;
+        long idleWakeups = 0;                        //wake-ups that found nothing to draw
+
+        FramePacer framePacer;                       //vsync-locked presents + judder stats
 };
 
 
@@ -0,0 +1,141 @@
+#include "AudioGain.h"
+
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VCPLAYER_GAIN_X86 1
+#include <immintrin.h>
+#endif
+
+
+// Gain at sample i of a ramp
+static inline float rampGain(float start, float step, size_t i) {
+    return start + step * static_cast<float>(i);
+}
+
+static inline float rampStep(size_t count, float startGain, float endGain) {
+    return count > 1 ? (endGain - startGain) / static_cast<float>(count - 1) : 0.0f;
+}
+
+static inline int16_t saturateS16(float v) {
+    long r = std::lrintf(v);
+    if (r > INT16_MAX) return INT16_MAX;
+    if (r < INT16_MIN) return INT16_MIN;
+    return static_cast<int16_t>(r);
+}
+
+// ==================== SCALAR ====================
+static void applyFloatScalar(float* samples, size_t count, float startGain, float endGain) {
+    float step = rampStep(count, startGain, endGain);
+    for (size_t i = 0; i < count; i++) {
+        samples[i] *= rampGain(startGain, step, i);
+    }
+}
+
+static void applyS16Scalar(int16_t* samples, size_t count, float startGain, float endGain) {
+    float step = rampStep(count, startGain, endGain);
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = saturateS16(samples[i] * rampGain(startGain, step, i));
+    }
+}
+
+#ifdef VCPLAYER_GAIN_X86
+// ==================== SSE2 ====================
+__attribute__((target("sse2")))
+static void applyFloatSSE2(float* samples, size_t count, float startGain, float endGain) {
+    float step = rampStep(count, startGain, endGain);
+    __m128 gain = _mm_setr_ps(startGain, startGain + step, startGain + 2 * step, startGain + 3 * step);
+    __m128 gainStep = _mm_set1_ps(4 * step);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), gain));
+        gain = _mm_add_ps(gain, gainStep);
+    }
+    for (; i < count; i++) samples[i] *= rampGain(startGain, step, i);
+}
+
+__attribute__((target("sse2")))
+static void applyS16SSE2(int16_t* samples, size_t count, float startGain, float endGain) {
+    float step = rampStep(count, startGain, endGain);
+    __m128 gainLo = _mm_setr_ps(startGain, startGain + step, startGain + 2 * step, startGain + 3 * step);
+    __m128 gainHi = _mm_add_ps(gainLo, _mm_set1_ps(4 * step));
+    __m128 gainStep = _mm_set1_ps(8 * step);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        // Sign-extend to 32 bit by placing each sample in the high half and shifting back down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+        lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), gainLo));
+        hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), gainHi));
+        // packs saturates to the int16 range
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i), _mm_packs_epi32(lo, hi));
+        gainLo = _mm_add_ps(gainLo, gainStep);
+        gainHi = _mm_add_ps(gainHi, gainStep);
+    }
+    for (; i < count; i++) samples[i] = saturateS16(samples[i] * rampGain(startGain, step, i));
+}
+
+// ==================== AVX2 ====================
+__attribute__((target("avx2")))
+static void applyFloatAVX2(float* samples, size_t count, float startGain, float endGain) {
+    float step = rampStep(count, startGain, endGain);
+    __m256 gain = _mm256_add_ps(_mm256_set1_ps(startGain),
+                                _mm256_mul_ps(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps(step)));
+    __m256 gainStep = _mm256_set1_ps(8 * step);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), gain));
+        gain = _mm256_add_ps(gain, gainStep);
+    }
+    for (; i < count; i++) samples[i] *= rampGain(startGain, step, i);
+}
+
+__attribute__((target("avx2")))
+static void applyS16AVX2(int16_t* samples, size_t count, float startGain, float endGain) {
+    float step = rampStep(count, startGain, endGain);
+    __m256 gainLo = _mm256_add_ps(_mm256_set1_ps(startGain),
+                                  _mm256_mul_ps(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps(step)));
+    __m256 gainHi = _mm256_add_ps(gainLo, _mm256_set1_ps(8 * step));
+    __m256 gainStep = _mm256_set1_ps(16 * step);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i));
+        __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(in));
+        __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(in, 1));
+        lo = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(lo), gainLo));
+        hi = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(hi), gainHi));
+        // packs works per 128-bit lane; the permute restores sample order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(samples + i), packed);
+        gainLo = _mm256_add_ps(gainLo, gainStep);
+        gainHi = _mm256_add_ps(gainHi, gainStep);
+    }
+    for (; i < count; i++) samples[i] = saturateS16(samples[i] * rampGain(startGain, step, i));
+}
+#endif
+
+std::vector<GainKernels> availableGainKernels() {
+    std::vector<GainKernels> kernels;
+    kernels.push_back({"scalar", applyFloatScalar, applyS16Scalar});
+#ifdef VCPLAYER_GAIN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) kernels.push_back({"sse2", applyFloatSSE2, applyS16SSE2});
+    if (__builtin_cpu_supports("avx2")) kernels.push_back({"avx2", applyFloatAVX2, applyS16AVX2});
+#endif
+    return kernels;
+}
+
+const GainKernels& activeGainKernels() {
+    // Runtime dispatch: the last available kernel is the widest one
+    static const GainKernels best = availableGainKernels().back();
+    return best;
+}
+
+void applyGainFloat(float* samples, size_t count, float startGain, float endGain) {
+    activeGainKernels().applyFloat(samples, count, startGain, endGain);
+}
+
+void applyGainS16(int16_t* samples, size_t count, float startGain, float endGain) {
+    activeGainKernels().applyS16(samples, count, startGain, endGain);
+}
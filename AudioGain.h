@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Volume stage for interleaved PCM. Gain ramps linearly from startGain (first sample) towards
+// endGain (last sample) so volume changes do not produce zipper noise; pass the same value
+// twice for a constant gain. s16 output saturates instead of wrapping.
+struct GainKernels {
+    const char* name;
+    void (*applyFloat)(float* samples, size_t count, float startGain, float endGain);
+    void (*applyS16)(int16_t* samples, size_t count, float startGain, float endGain);
+};
+
+// Best implementation for this CPU (AVX2, SSE2 or scalar), picked once at first use
+const GainKernels& activeGainKernels();
+// Every implementation the CPU can run, scalar first (for the microbenchmark)
+std::vector<GainKernels> availableGainKernels();
+
+void applyGainFloat(float* samples, size_t count, float startGain, float endGain);
+void applyGainS16(int16_t* samples, size_t count, float startGain, float endGain);
@@ -0,0 +1,72 @@
+#include "AudioRingBuffer.h"
+
+#include <cstring>
+
+
+void AudioRingBuffer::reset(size_t minCapacity) {
+    size_t size = 1;
+    while (size < minCapacity) size <<= 1;
+    buffer.assign(size, 0);
+    mask = size - 1;
+    clear();
+}
+
+void AudioRingBuffer::clear() {
+    writePos.store(0, std::memory_order_relaxed);
+    readPos.store(0, std::memory_order_relaxed);
+}
+
+size_t AudioRingBuffer::write(const uint8_t* data, size_t size) {
+    if (buffer.empty()) return 0;
+    uint64_t w = writePos.load(std::memory_order_relaxed);
+    uint64_t r = readPos.load(std::memory_order_acquire);
+    size_t space = buffer.size() - static_cast<size_t>(w - r);
+    if (size > space) size = space;
+
+    // Copy in at most two pieces: up to the end of the storage, then from the start
+    size_t offset = static_cast<size_t>(w) & mask;
+    size_t first = buffer.size() - offset;
+    if (first > size) first = size;
+    std::memcpy(&buffer[offset], data, first);
+    std::memcpy(&buffer[0], data + first, size - first);
+
+    writePos.store(w + size, std::memory_order_release);
+    return size;
+}
+
+size_t AudioRingBuffer::read(uint8_t* data, size_t size) {
+    if (buffer.empty()) return 0;
+    uint64_t r = readPos.load(std::memory_order_relaxed);
+    uint64_t w = writePos.load(std::memory_order_acquire);
+    size_t ready = static_cast<size_t>(w - r);
+    if (size > ready) size = ready;
+
+    size_t offset = static_cast<size_t>(r) & mask;
+    size_t first = buffer.size() - offset;
+    if (first > size) first = size;
+    std::memcpy(data, &buffer[offset], first);
+    std::memcpy(data + first, &buffer[0], size - first);
+
+    readPos.store(r + size, std::memory_order_release);
+    return size;
+}
+
+size_t AudioRingBuffer::available() const {
+    return static_cast<size_t>(writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_acquire));
+}
+
+size_t AudioRingBuffer::freeSpace() const {
+    return buffer.size() - available();
+}
+
+size_t AudioRingBuffer::capacity() const {
+    return buffer.size();
+}
+
+uint64_t AudioRingBuffer::totalRead() const {
+    return readPos.load(std::memory_order_acquire);
+}
+
+uint64_t AudioRingBuffer::totalWritten() const {
+    return writePos.load(std::memory_order_acquire);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lock-free single-producer/single-consumer byte ring for PCM.
+// The audio decode thread is the only writer and the SDL audio callback the only reader, so
+// the steady state needs no locks; reset() must only run while neither side is active
+// (the producer calls it with the audio device locked).
+class AudioRingBuffer
+{
+private:
+    std::vector<uint8_t> buffer;
+    size_t mask = 0;                       // capacity - 1 (capacity is a power of two)
+    std::atomic<uint64_t> writePos{0};     // total bytes ever written (producer owned)
+    std::atomic<uint64_t> readPos{0};      // total bytes ever read (consumer owned)
+
+public:
+    // Allocate at least minCapacity bytes (rounded up to a power of two) and empty the ring
+    void reset(size_t minCapacity);
+    // Empty the ring, keeping its storage
+    void clear();
+
+    size_t write(const uint8_t* data, size_t size);  // producer: returns bytes actually stored
+    size_t read(uint8_t* data, size_t size);         // consumer: returns bytes actually copied
+
+    size_t available() const;   // bytes ready for the consumer
+    size_t freeSpace() const;   // bytes the producer can still write
+    size_t capacity() const;
+    uint64_t totalRead() const; // bytes consumed since the last reset/clear
+    uint64_t totalWritten() const; // bytes produced since the last reset/clear
+};
@@ -0,0 +1,639 @@
+// Headless decode benchmark: drives the player's own demux -> decode -> convert pipeline
+// (InputOpener, PacketQueue, FrameQueue, FrameScaler) without SDL, so codec and thread
+// settings can be compared on any machine.
+//
+//   vcplayer_bench <file> [--threads N] [--thread-mode auto|frame|slice|off] [--lowres N]
+//                         [--convert rgb24|auto|none] [--scale WxH] [--scaler name]
+//                         [--scale-threads N] [--scale-compare]
+//                         [--io file|mmap|prefetch] [--prefetch-mb N] [--fast-open] [--stream-cache]
+//                         [--max-frames N] [--json] [--output path]
+#include "DecoderConfig.h"
+#include "FrameQueue.h"
+#include "FrameScaler.h"
+#include "InputOpener.h"
+#include "PacketQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+extern "C"{
+    #include <libavformat/avformat.h>
+    #include <libavcodec/avcodec.h>
+    #include <libavutil/imgutils.h>
+    #include <libswscale/swscale.h>
+}
+
+
+// ==================== ALLOCATION COUNTING ====================
+// Every heap allocation in the process (FFmpeg's av_malloc included) goes through these
+static std::atomic<uint64_t> allocationCount{0};
+
+#if defined(__GLIBC__)
+// glibc lets the executable interpose the malloc family; forward to the real allocator
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+void* calloc(size_t count, size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+void* realloc(void* ptr, size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+void* memalign(size_t alignment, size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+void* aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+int posix_memalign(void** out, size_t alignment, size_t size) {
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1))) return EINVAL;
+    void* ptr = memalign(alignment, size);
+    if (!ptr) return ENOMEM;
+    *out = ptr;
+    return 0;
+}
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+}
+#else
+// Elsewhere only C++ allocations are visible
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+#endif
+
+
+// ==================== OPTIONS ====================
+enum class ConvertMode {
+    RGB24,  // always convert to RGB24 (the player's fallback path)
+    Auto,   // skip formats the player uploads directly (yuv420p, nv12)
+    None    // decode only
+};
+
+struct BenchOptions {
+    std::string file;
+    DecoderThreadingOptions threading;
+    int lowres = 0;         // reduced-resolution decode level (capped at what the codec supports)
+    ConvertMode convert = ConvertMode::RGB24;
+    int scaleWidth = 0;     // --scale: fit pictures into this box like the player window (0: source size)
+    int scaleHeight = 0;
+    ScaleAlgorithm scaler = ScaleAlgorithm::Bilinear;
+    int scaleThreads = 0;   // swscale slice threads (0: automatic like the player, 1: single-threaded)
+    bool scaleCompare = false; // also time one picture's conversion single-threaded vs sliced
+    bool mmapIO = false;    // read through MmapIO instead of FFmpeg's file protocol
+    bool prefetch = false;  // read through PrefetchIO
+    long prefetchMB = 16;
+    bool fastOpen = false;     // bounded probing (same limits as VideoPlayer's fast-open defaults)
+    bool streamCache = false;  // restore/store stream parameters like VideoPlayer does
+    long maxFrames = 0;     // 0: whole file
+    bool json = false;
+    std::string output;     // empty: stdout
+};
+
+static void printUsage() {
+    fprintf(stderr,
+        "usage: vcplayer_bench <file> [--threads N] [--thread-mode auto|frame|slice|off] [--lowres N]\n"
+        "                      [--convert rgb24|auto|none] [--scale WxH] [--scaler name]\n"
+        "                      [--scale-threads N] [--scale-compare]\n"
+        "                      [--io file|mmap|prefetch] [--prefetch-mb N] [--fast-open] [--stream-cache]\n"
+        "                      [--max-frames N] [--json] [--output path]\n");
+}
+
+static bool parseArgs(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--threads" && hasValue) {
+            options.threading.defaults.threadCount = atoi(argv[++i]);
+        } else if (arg == "--thread-mode" && hasValue) {
+            std::string mode = argv[++i];
+            if (mode == "auto") options.threading.defaults.mode = DecoderThreadMode::Auto;
+            else if (mode == "frame") options.threading.defaults.mode = DecoderThreadMode::Frame;
+            else if (mode == "slice") options.threading.defaults.mode = DecoderThreadMode::Slice;
+            else if (mode == "off") options.threading.defaults.mode = DecoderThreadMode::Off;
+            else return false;
+        } else if (arg == "--lowres" && hasValue) {
+            options.lowres = atoi(argv[++i]);
+            if (options.lowres < 0) return false;
+        } else if (arg == "--convert" && hasValue) {
+            std::string mode = argv[++i];
+            if (mode == "rgb24") options.convert = ConvertMode::RGB24;
+            else if (mode == "auto") options.convert = ConvertMode::Auto;
+            else if (mode == "none") options.convert = ConvertMode::None;
+            else return false;
+        } else if (arg == "--scale" && hasValue) {
+            if (sscanf(argv[++i], "%dx%d", &options.scaleWidth, &options.scaleHeight) != 2) return false;
+            if (options.scaleWidth <= 0 || options.scaleHeight <= 0) return false;
+        } else if (arg == "--scaler" && hasValue) {
+            if (!parseScaleAlgorithm(argv[++i], &options.scaler)) return false;
+        } else if (arg == "--scale-threads" && hasValue) {
+            options.scaleThreads = atoi(argv[++i]);
+            if (options.scaleThreads < 0) return false;
+        } else if (arg == "--scale-compare") {
+            options.scaleCompare = true;
+        } else if (arg == "--io" && hasValue) {
+            std::string mode = argv[++i];
+            options.mmapIO = mode == "mmap";
+            options.prefetch = mode == "prefetch";
+            if (mode != "file" && mode != "mmap" && mode != "prefetch") return false;
+        } else if (arg == "--prefetch-mb" && hasValue) {
+            options.prefetchMB = atol(argv[++i]);
+            if (options.prefetchMB <= 0) return false;
+        } else if (arg == "--fast-open") {
+            options.fastOpen = true;
+        } else if (arg == "--stream-cache") {
+            options.streamCache = true;
+        } else if (arg == "--max-frames" && hasValue) {
+            options.maxFrames = atol(argv[++i]);
+        } else if (arg == "--json") {
+            options.json = true;
+        } else if (arg == "--output" && hasValue) {
+            options.output = argv[++i];
+        } else if (arg[0] != '-' && options.file.empty()) {
+            options.file = arg;
+        } else {
+            return false;
+        }
+    }
+    return !options.file.empty();
+}
+
+
+// ==================== MEASUREMENT ====================
+// Per-call latencies of one pipeline stage, in milliseconds
+struct StageTimes {
+    std::vector<double> samples;
+    double total = 0.0;
+
+    void reserve(size_t count) {
+        samples.reserve(count);
+    }
+    void add(double ms) {
+        samples.push_back(ms);
+        total += ms;
+    }
+    // Nearest-rank percentile
+    double percentile(double p) {
+        if (samples.empty()) return 0.0;
+        std::sort(samples.begin(), samples.end());
+        size_t rank = static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+        return samples[rank];
+    }
+};
+
+static double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static long peakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // kilobytes on Linux
+}
+
+struct BenchResult {
+    std::string codec;
+    int width = 0, height = 0;
+    std::string pixelFormat;
+    int threads = 0;
+    int lowres = 0;
+    const char* threadType = "none";
+    long packets = 0;
+    long framesDecoded = 0;
+    long framesConverted = 0;
+    int outputWidth = 0, outputHeight = 0;   // size of the last converted picture
+    int scaleThreads = 0;                    // slice threads the converter ran with
+    int compareThreads = 0;                  // --scale-compare: ms per conversion, 1 thread vs compareThreads
+    double compareSingleMs = 0.0;
+    double compareThreadedMs = 0.0;
+    double wallMs = 0.0;
+    StageTimes demux, decode, convert;
+    uint64_t allocations = 0;        // during the decode loop only (setup excluded, queues included)
+    long peakRss = 0;
+    const char* io = "file";
+    MmapIO::Stats ioStats;           // mmap reads only
+    PrefetchIO::Stats prefetchStats;
+    double openMs = 0.0;             // open + stream info
+    const char* streamInfo = "probe";
+};
+
+
+// ==================== PIPELINE ====================
+static const int kCompareRuns = 50;   // conversions per configuration in --scale-compare
+// Queue sizes of the player (VideoPlayer's video queue and frame queue defaults)
+static const size_t kBenchQueueBytes = 64 * 1024 * 1024;
+static const double kBenchQueueSeconds = 5.0;
+static const int kBenchFrameQueueDepth = 4;
+static const int kPacketWaitMs = 10;
+static const long kDefaultExpectedFrames = 1 << 16;   // sample reservation when the length is unknown
+static bool needsConvert(ConvertMode mode, int format) {
+    if (mode == ConvertMode::None) return false;
+    if (mode == ConvertMode::Auto) return format != AV_PIX_FMT_YUV420P && format != AV_PIX_FMT_NV12;
+    return true;
+}
+
+// Output of the convert stage, decided like VideoPlayer::queuePicture: the --scale box plays the
+// window (the picture is fitted into it keeping its aspect, like the display rectangle) and in
+// auto mode yuv420p/nv12 count as uploadable, so they keep their layout and are only converted
+// when that halves them (scaleToBox). False: the picture goes into the queue as decoded.
+static bool planConvert(const BenchOptions& options, const AVFrame* frame, AVPixelFormat* format, int* w, int* h) {
+    *format = AV_PIX_FMT_RGB24;
+    *w = frame->width;
+    *h = frame->height;
+    if (options.convert == ConvertMode::None) return false;
+    int boxWidth = 0, boxHeight = 0;
+    if (options.scaleWidth > 0 && frame->width > 0 && frame->height > 0) {
+        double aspect = static_cast<double>(frame->width) / frame->height;
+        boxWidth = options.scaleWidth;
+        boxHeight = static_cast<int>(boxWidth / aspect + 0.5);
+        if (boxHeight > options.scaleHeight) {
+            boxHeight = options.scaleHeight;
+            boxWidth = static_cast<int>(boxHeight * aspect + 0.5);
+        }
+        boxWidth = (boxWidth + kScaleAlign - 1) / kScaleAlign * kScaleAlign;
+        boxHeight = (boxHeight + kScaleAlign - 1) / kScaleAlign * kScaleAlign;
+    }
+    bool uploadable = !needsConvert(options.convert, frame->format);
+    bool shrink = scaleToBox(frame->width, frame->height, boxWidth, boxHeight, uploadable, w, h);
+    if (!uploadable) return true;
+    if (!shrink) return false;
+    *format = (AVPixelFormat)frame->format;
+    return true;
+}
+
+// Convert one picture over and over, single-threaded and with slice threads, so the gain of
+// threaded conversion shows without decode and I/O noise
+static void compareScaling(const BenchOptions& options, const AVFrame* picture, BenchResult& result) {
+    AVPixelFormat format;
+    int w, h;
+    planConvert(options, picture, &format, &w, &h);
+    int threads[2] = {1, options.scaleThreads == 1 ? 0 : options.scaleThreads};
+    double* msPerRun[2] = {&result.compareSingleMs, &result.compareThreadedMs};
+    for (int i = 0; i < 2; i++) {
+        FrameScaler scaler;
+        scaler.setThreads(threads[i]);
+        AVFrame* converted = av_frame_alloc();
+        // Warm-up: builds the context, the slice threads and the output buffer
+        scaler.scale(picture, converted, format, w, h, options.scaler);
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < kCompareRuns; run++) scaler.scale(picture, converted, format, w, h, options.scaler);
+        *msPerRun[i] = msSince(start) / kCompareRuns;
+        if (i == 1) result.compareThreads = scaler.getActiveThreads();
+        av_frame_free(&converted);
+    }
+}
+
+static bool runBench(const BenchOptions& options, BenchResult& result) {
+    // Opened exactly like VideoPlayer::openStream (both readers outlive fmtCtx)
+    MmapIO mmapIO;
+    PrefetchIO prefetchIO;
+    StreamInfoCache streamInfoCache;
+    InputOptions input;
+    input.mmapIO = options.mmapIO;
+    input.prefetchBytes = options.prefetch ? static_cast<size_t>(options.prefetchMB) * 1024 * 1024 : 0;
+    input.fastOpen = options.fastOpen;
+    input.streamInfoCache = options.streamCache;
+    AVFormatContext* fmtCtx = nullptr;
+    auto openStart = std::chrono::steady_clock::now();
+    if (!openInput(options.file, input, &mmapIO, &prefetchIO, streamInfoCache, &fmtCtx, &result.streamInfo)) {
+        return false;
+    }
+    result.openMs = msSince(openStart);
+    // Like the player, a file that cannot be mapped (or prefetched) falls back to FFmpeg's I/O
+    result.io = mmapIO.isOpen() ? "mmap" : prefetchIO.isOpen() ? "prefetch" : "file";
+    int streamIndex = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (streamIndex < 0) {
+        fprintf(stderr, "No video stream found\n");
+        avformat_close_input(&fmtCtx);
+        return false;
+    }
+    AVStream* stream = fmtCtx->streams[streamIndex];
+    const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!codec) {
+        fprintf(stderr, "Video decoder not found\n");
+        avformat_close_input(&fmtCtx);
+        return false;
+    }
+    AVCodecContext* codecCtx = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(codecCtx, stream->codecpar);
+    codecCtx->lowres = std::min<int>(options.lowres, codec->max_lowres);
+    applyDecoderThreading(codecCtx, codec, options.threading);
+    if (avcodec_open2(codecCtx, codec, nullptr) < 0) {
+        fprintf(stderr, "Failed to open video decoder\n");
+        avcodec_free_context(&codecCtx);
+        avformat_close_input(&fmtCtx);
+        return false;
+    }
+    result.codec = codec->name;
+    result.threads = codecCtx->thread_count;
+    result.threadType = describeThreadType(codecCtx->active_thread_type);
+    result.lowres = codecCtx->lowres;
+
+    // Latency samples are kept for the percentiles: size them up front so the timed loop
+    // does not reallocate (a wrong guess only costs an occasional regrowth)
+    long expected = options.maxFrames;
+    if (expected <= 0 && stream->nb_frames > 0) expected = static_cast<long>(stream->nb_frames);
+    if (expected <= 0 && fmtCtx->duration > 0) {
+        AVRational rate = stream->avg_frame_rate.num > 0 ? stream->avg_frame_rate : AVRational{25, 1};
+        expected = static_cast<long>(fmtCtx->duration / (double)AV_TIME_BASE * av_q2d(rate)) + 1;
+    }
+    if (expected <= 0) expected = kDefaultExpectedFrames;
+    result.demux.reserve(static_cast<size_t>(expected) * fmtCtx->nb_streams);
+    result.decode.reserve(expected);
+    result.convert.reserve(expected);
+
+    // The player's pipeline: a demux thread reads ahead into a PacketQueue, the decoder takes
+    // packets from it and fills FrameQueue slots (converting into their buffers, or taking a
+    // reference when the picture needs no conversion). The bench is its own render thread and
+    // releases every picture as soon as it is queued.
+    PacketQueue packets(kBenchQueueBytes, kBenchQueueSeconds);
+    FrameQueue pictures(kBenchFrameQueueDepth);
+    packets.setTimeBase(stream->time_base);
+    std::mutex demuxMutex;
+    std::condition_variable demuxCond;
+    std::atomic<bool> stopDemux{false};
+    std::atomic<bool> demuxDone{false};
+    packets.setSpaceCallback([&] {
+        std::lock_guard<std::mutex> lock(demuxMutex);
+        demuxCond.notify_all();
+    });
+
+    AVPacket* pkt = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    AVFrame* sample = av_frame_alloc();   // last converted picture, for --scale-compare
+    FrameScaler scaler;
+    scaler.setThreads(options.scaleThreads);
+
+    // Decode the frames that the last send produced; returns false once the decoder is drained
+    auto receiveFrames = [&](std::chrono::steady_clock::time_point sendStart) {
+        while (true) {
+            int ret = avcodec_receive_frame(codecCtx, frame);
+            if (ret == AVERROR(EAGAIN)) return true;
+            if (ret < 0) return false;
+            // Latency of a picture: from feeding its packet to getting it out of the decoder
+            result.decode.add(msSince(sendStart));
+            result.framesDecoded++;
+            result.width = frame->width;
+            result.height = frame->height;
+            const char* fmtName = av_get_pix_fmt_name((AVPixelFormat)frame->format);
+            result.pixelFormat = fmtName ? fmtName : "unknown";
+
+            FrameQueue::Frame* slot = pictures.peekWritable();
+            AVPixelFormat outFormat;
+            int outWidth, outHeight;
+            if (planConvert(options, frame, &outFormat, &outWidth, &outHeight)) {
+                if (options.scaleCompare) {
+                    av_frame_unref(sample);
+                    av_frame_ref(sample, frame);
+                }
+                auto convertStart = std::chrono::steady_clock::now();
+                // Same scaler and slot buffer reuse as VideoPlayer::queuePicture
+                if (!scaler.scale(frame, slot->frame, outFormat, outWidth, outHeight, options.scaler)) return false;
+                result.convert.add(msSince(convertStart));
+                result.framesConverted++;
+                result.outputWidth = outWidth;
+                result.outputHeight = outHeight;
+                result.scaleThreads = scaler.getActiveThreads();
+                av_frame_unref(frame);
+            } else {
+                av_frame_unref(slot->frame);
+                av_frame_move_ref(slot->frame, frame);
+            }
+            pictures.push();
+            pictures.next();   // "shown": the slot is free for the next picture
+            if (options.maxFrames > 0 && result.framesDecoded >= options.maxFrames) return false;
+        }
+    };
+
+    uint64_t allocationsBefore = allocationCount.load();
+    auto wallStart = std::chrono::steady_clock::now();
+    std::thread demuxer([&] {
+        AVPacket* readPkt = av_packet_alloc();
+        while (true) {
+            {
+                // Read-ahead is bounded like the player's: wait for the decoder to make room
+                std::unique_lock<std::mutex> lock(demuxMutex);
+                demuxCond.wait(lock, [&] { return stopDemux || !packets.isFull(); });
+                if (stopDemux) break;
+            }
+            auto demuxStart = std::chrono::steady_clock::now();
+            int ret = av_read_frame(fmtCtx, readPkt);
+            if (ret < 0) break; // EOF (or read error): the decoder drains what is queued
+            result.demux.add(msSince(demuxStart));
+            if (readPkt->stream_index != streamIndex) {
+                av_packet_unref(readPkt);
+                continue;
+            }
+            result.packets++;
+            packets.put(readPkt);
+        }
+        av_packet_free(&readPkt);
+        demuxDone = true;
+    });
+
+    bool decoding = true;
+    while (decoding) {
+        if (!packets.get(pkt, nullptr, kPacketWaitMs)) {
+            if (demuxDone && packets.isEmpty()) break;
+            continue;
+        }
+        auto sendStart = std::chrono::steady_clock::now();
+        avcodec_send_packet(codecCtx, pkt);
+        av_packet_unref(pkt);
+        decoding = receiveFrames(sendStart);
+    }
+    if (decoding) {
+        // Flush the pictures still held by frame threads
+        auto sendStart = std::chrono::steady_clock::now();
+        avcodec_send_packet(codecCtx, nullptr);
+        receiveFrames(sendStart);
+    }
+    {
+        std::lock_guard<std::mutex> lock(demuxMutex);
+        stopDemux = true;
+    }
+    demuxCond.notify_all();
+    demuxer.join();
+    result.wallMs = msSince(wallStart);
+    result.allocations = allocationCount.load() - allocationsBefore;
+    result.peakRss = peakRssKb();
+    result.ioStats = mmapIO.getStats();
+    result.prefetchStats = prefetchIO.getStats();
+    if (options.scaleCompare && sample->buf[0]) compareScaling(options, sample, result);
+
+    packets.flush();
+    pictures.clear();
+    av_frame_free(&sample);
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    avcodec_free_context(&codecCtx);
+    avformat_close_input(&fmtCtx);
+    return true;
+}
+
+
+// ==================== REPORT ====================
+static double fps(long frames, double ms) {
+    return ms > 0.0 ? frames * 1000.0 / ms : 0.0;
+}
+
+static void writeStageJson(FILE* out, const char* name, StageTimes& stage, bool last) {
+    fprintf(out, "    \"%s\": {\"count\": %zu, \"total_ms\": %.3f, \"p50_ms\": %.3f, \"p90_ms\": %.3f, "
+                 "\"p99_ms\": %.3f, \"max_ms\": %.3f}%s\n",
+            name, stage.samples.size(), stage.total, stage.percentile(50), stage.percentile(90),
+            stage.percentile(99), stage.percentile(100), last ? "" : ",");
+}
+
+static std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static void writeJson(FILE* out, const BenchOptions& options, BenchResult& r) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"file\": \"%s\",\n", jsonEscape(options.file).c_str());
+    fprintf(out, "  \"codec\": \"%s\",\n", r.codec.c_str());
+    fprintf(out, "  \"width\": %d,\n  \"height\": %d,\n", r.width, r.height);
+    fprintf(out, "  \"pixel_format\": \"%s\",\n", r.pixelFormat.c_str());
+    fprintf(out, "  \"threads\": %d,\n  \"thread_type\": \"%s\",\n", r.threads, r.threadType);
+    fprintf(out, "  \"lowres\": %d,\n", r.lowres);
+    fprintf(out, "  \"packets\": %ld,\n", r.packets);
+    fprintf(out, "  \"frames_decoded\": %ld,\n  \"frames_converted\": %ld,\n", r.framesDecoded, r.framesConverted);
+    fprintf(out, "  \"output_width\": %d,\n  \"output_height\": %d,\n  \"scaler\": \"%s\",\n",
+            r.outputWidth, r.outputHeight, scaleAlgorithmName(options.scaler));
+    fprintf(out, "  \"scale_threads\": %d,\n", r.scaleThreads);
+    if (options.scaleCompare) {
+        fprintf(out, "  \"scale_compare\": {\"single_ms\": %.3f, \"threaded_ms\": %.3f, \"threads\": %d, \"speedup\": %.2f},\n",
+                r.compareSingleMs, r.compareThreadedMs, r.compareThreads,
+                r.compareThreadedMs > 0.0 ? r.compareSingleMs / r.compareThreadedMs : 0.0);
+    }
+    fprintf(out, "  \"open_ms\": %.3f,\n  \"stream_info\": \"%s\",\n", r.openMs, r.streamInfo);
+    fprintf(out, "  \"wall_ms\": %.3f,\n", r.wallMs);
+    fprintf(out, "  \"pipeline_fps\": %.2f,\n", fps(r.framesDecoded, r.wallMs));
+    // Demux runs on its own thread: only conversion is taken off the wall time
+    fprintf(out, "  \"decode_fps\": %.2f,\n", fps(r.framesDecoded, r.wallMs - r.convert.total));
+    fprintf(out, "  \"convert_fps\": %.2f,\n", fps(r.framesConverted, r.convert.total));
+    fprintf(out, "  \"stages\": {\n");
+    writeStageJson(out, "demux", r.demux, false);
+    writeStageJson(out, "decode", r.decode, false);
+    writeStageJson(out, "convert", r.convert, true);
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"allocations\": %llu,\n", (unsigned long long)r.allocations);
+    fprintf(out, "  \"allocations_per_frame\": %.2f,\n",
+            r.framesDecoded ? (double)r.allocations / r.framesDecoded : 0.0);
+    fprintf(out, "  \"peak_rss_kb\": %ld,\n", r.peakRss);
+    fprintf(out, "  \"io\": \"%s\",\n", r.io);
+    fprintf(out, "  \"io_reads\": %llu,\n  \"io_seeks\": %llu,\n  \"io_advice_changes\": %llu,\n",
+            (unsigned long long)r.ioStats.reads, (unsigned long long)r.ioStats.seeks,
+            (unsigned long long)r.ioStats.adviceChanges);
+    fprintf(out, "  \"prefetch_backend\": \"%s\",\n  \"prefetch_stalls\": %llu,\n  \"prefetch_stall_ms\": %.3f\n",
+            r.prefetchStats.backend, (unsigned long long)r.prefetchStats.stalls, r.prefetchStats.stallMs);
+    fprintf(out, "}\n");
+}
+
+static void writeStageText(FILE* out, const char* name, StageTimes& stage) {
+    fprintf(out, "  %-8s n=%-7zu p50 %7.3f ms  p90 %7.3f ms  p99 %7.3f ms  max %7.3f ms\n",
+            name, stage.samples.size(), stage.percentile(50), stage.percentile(90),
+            stage.percentile(99), stage.percentile(100));
+}
+
+static void writeText(FILE* out, const BenchOptions& options, BenchResult& r) {
+    fprintf(out, "%s %dx%d %s, %d thread(s) (%s)\n", r.codec.c_str(), r.width, r.height,
+            r.pixelFormat.c_str(), r.threads, r.threadType);
+    if (r.lowres > 0) fprintf(out, "lowres: decoding at 1/%d of the coded size\n", 1 << r.lowres);
+    fprintf(out, "open: %.1f ms (stream info: %s)\n", r.openMs, r.streamInfo);
+    fprintf(out, "frames: %ld decoded, %ld converted in %.1f ms\n", r.framesDecoded, r.framesConverted, r.wallMs);
+    if (r.framesConverted > 0) {
+        fprintf(out, "converted to %dx%d (%s, %d slice thread(s))\n", r.outputWidth, r.outputHeight,
+                scaleAlgorithmName(options.scaler), r.scaleThreads);
+    }
+    if (r.compareThreads > 0) {
+        fprintf(out, "scale compare: %.2f ms single-threaded, %.2f ms with %d threads (%.1fx)\n",
+                r.compareSingleMs, r.compareThreadedMs, r.compareThreads,
+                r.compareThreadedMs > 0.0 ? r.compareSingleMs / r.compareThreadedMs : 0.0);
+    }
+    fprintf(out, "pipeline %.1f fps, decode %.1f fps, convert %.1f fps\n",
+            fps(r.framesDecoded, r.wallMs),
+            fps(r.framesDecoded, r.wallMs - r.convert.total),
+            fps(r.framesConverted, r.convert.total));
+    writeStageText(out, "demux", r.demux);
+    writeStageText(out, "decode", r.decode);
+    writeStageText(out, "convert", r.convert);
+    fprintf(out, "allocations: %llu (%.1f per frame), peak RSS %ld KB\n",
+            (unsigned long long)r.allocations,
+            r.framesDecoded ? (double)r.allocations / r.framesDecoded : 0.0, r.peakRss);
+    if (r.ioStats.reads > 0) {
+        fprintf(out, "io: %s, %llu reads (%.1f MB), %llu seeks, %llu madvise switches\n", r.io,
+                (unsigned long long)r.ioStats.reads, r.ioStats.bytesRead / (1024.0 * 1024.0),
+                (unsigned long long)r.ioStats.seeks, (unsigned long long)r.ioStats.adviceChanges);
+    }
+    if (r.prefetchStats.reads > 0) {
+        fprintf(out, "prefetch: %s, %llu reads, %llu stalled for %.1f ms, %llu blocks fetched\n",
+                r.prefetchStats.backend, (unsigned long long)r.prefetchStats.reads,
+                (unsigned long long)r.prefetchStats.stalls, r.prefetchStats.stallMs,
+                (unsigned long long)r.prefetchStats.blocksFetched);
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+    BenchResult result;
+    if (!runBench(options, result)) return 1;
+
+    FILE* out = stdout;
+    if (!options.output.empty()) {
+        out = fopen(options.output.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "Failed to open %s\n", options.output.c_str());
+            return 1;
+        }
+    }
+    if (options.json) writeJson(out, options, result);
+    else writeText(out, options, result);
+    if (out != stdout) fclose(out);
+    return 0;
+}
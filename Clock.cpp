@@ -0,0 +1,50 @@
+#include "Clock.h"
+
+#include <chrono>
+
+
+void Clock::set(double pts) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ptsAtUpdate = pts;
+    updatedAt = now();
+}
+
+double Clock::get() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (paused) return ptsAtUpdate;
+    return ptsAtUpdate + (now() - updatedAt) * rate;
+}
+
+// Freeze (or resume) the clock at its current value
+void Clock::setPaused(bool pause) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pause == paused) return;
+    double t = now();
+    if (pause) ptsAtUpdate += (t - updatedAt) * rate;
+    updatedAt = t;
+    paused = pause;
+}
+
+bool Clock::isPaused() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return paused;
+}
+
+void Clock::setRate(double newRate) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (newRate == rate) return;
+    double t = now();
+    if (!paused) ptsAtUpdate += (t - updatedAt) * rate;
+    updatedAt = t;
+    rate = newRate;
+}
+
+double Clock::getRate() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rate;
+}
+
+double Clock::now() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <mutex>
+
+// Playback clock driven by the monotonic system clock: it reports the media time last set()
+// plus the wall time elapsed since then times the playback rate, and stands still while
+// paused. Used as the master clock for files without audio and as the fallback while the
+// audio clock is not valid.
+class Clock
+{
+private:
+    mutable std::mutex mutex;
+    double ptsAtUpdate = 0.0;   // media time at the last set(), in seconds
+    double updatedAt = 0.0;     // system time of the last set()
+    bool paused = false;
+    double rate = 1.0;          // media seconds per wall second
+
+public:
+    void set(double pts);
+    double get() const;
+    void setPaused(bool pause);
+    bool isPaused() const;
+    void setRate(double newRate);   // keeps the current value, only the pace changes
+    double getRate() const;
+
+    static double now();   // monotonic system time in seconds
+};
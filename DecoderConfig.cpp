@@ -0,0 +1,37 @@
+#include "DecoderConfig.h"
+
+#include <thread>
+
+
+void applyDecoderThreading(AVCodecContext* ctx, const AVCodec* codec, const DecoderThreadingOptions& options) {
+    DecoderThreadConfig config = options.defaults;
+    auto found = options.codecOverrides.find(codec->id);
+    if (found != options.codecOverrides.end()) config = found->second;
+
+    if (config.mode == DecoderThreadMode::Off) {
+        ctx->thread_count = 1;
+        ctx->thread_type = 0;
+        return;
+    }
+
+    int count = config.threadCount;
+    if (count <= 0) {
+        // One thread per core, capped; FFmpeg's own auto mode stops at 16 too but is not tunable
+        count = static_cast<int>(std::thread::hardware_concurrency());
+        if (count <= 0) count = 1;
+        if (count > kMaxAutoDecoderThreads) count = kMaxAutoDecoderThreads;
+    }
+    ctx->thread_count = count;
+
+    switch (config.mode) {
+        case DecoderThreadMode::Frame: ctx->thread_type = FF_THREAD_FRAME; break;
+        case DecoderThreadMode::Slice: ctx->thread_type = FF_THREAD_SLICE; break;
+        default:                       ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE; break;
+    }
+}
+
+const char* describeThreadType(int activeThreadType) {
+    if (activeThreadType & FF_THREAD_FRAME) return "frame";
+    if (activeThreadType & FF_THREAD_SLICE) return "slice";
+    return "none";
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <map>
+
+extern "C"{
+    #include <libavcodec/avcodec.h>
+}
+
+// How a decoder should spread work across cores
+enum class DecoderThreadMode {
+    Auto,    // let FFmpeg pick frame or slice threading, whichever the codec supports
+    Frame,   // frame threading only (best throughput, one frame of latency per thread)
+    Slice,   // slice threading only (no extra latency, scales with slices per picture)
+    Off      // single-threaded decode
+};
+
+struct DecoderThreadConfig {
+    int threadCount = 0;   // 0: pick from the number of cores
+    DecoderThreadMode mode = DecoderThreadMode::Auto;
+};
+
+struct DecoderThreadingOptions {
+    DecoderThreadConfig defaults;
+    std::map<AVCodecID, DecoderThreadConfig> codecOverrides;  // e.g. more threads for HEVC/AV1
+};
+
+// Frame threads each hold a picture in flight; beyond this the memory cost outweighs the gain
+static const int kMaxAutoDecoderThreads = 16;
+
+// Resolve the configuration for a codec and set thread_count/thread_type before avcodec_open2
+void applyDecoderThreading(AVCodecContext* ctx, const AVCodec* codec, const DecoderThreadingOptions& options);
+// Human readable form of AVCodecContext::active_thread_type (valid after avcodec_open2)
+const char* describeThreadType(int activeThreadType);
@@ -0,0 +1,156 @@
+#include "FrameCache.h"
+
+#include <iterator>
+
+
+FrameCache::FrameCache(size_t maxBytes) : maxBytes(maxBytes) {
+}
+
+FrameCache::~FrameCache() {
+    clear();
+}
+
+void FrameCache::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    maxBytes = bytes;
+    evictLocked();
+}
+
+void FrameCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& item : entries) {
+        av_frame_free(&item.second.frame);
+    }
+    entries.clear();
+    byteSize = 0;
+    haveLast = false;
+}
+
+// Memory the picture keeps alive (all planes, padding included)
+static size_t frameBytes(const AVFrame* frame) {
+    size_t bytes = 0;
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; i++) {
+        bytes += frame->buf[i]->size;
+    }
+    return bytes;
+}
+
+void FrameCache::insert(const AVFrame* frame, double pts, double duration, bool continues) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (maxBytes == 0) return;
+
+    // Linked when nothing else sits between this picture and the one inserted before it
+    bool linked = false;
+    auto next = entries.upper_bound(pts);
+    auto at = entries.find(pts);
+    if (continues && haveLast) {
+        auto prev = entries.lower_bound(pts);
+        if (prev != entries.begin()) linked = (--prev)->first == lastInsertPts;
+    }
+
+    if (at != entries.end()) {
+        // Decoded again (replayed span or a re-seek): keep the copy we have
+        if (linked) at->second.linked = true;
+    } else {
+        Entry entry;
+        entry.frame = av_frame_alloc();
+        if (!entry.frame || av_frame_ref(entry.frame, frame) < 0) {
+            av_frame_free(&entry.frame);
+            haveLast = false;
+            return;
+        }
+        entry.duration = duration;
+        entry.bytes = frameBytes(frame);
+        entry.linked = linked;
+        entries.emplace(pts, entry);
+        byteSize += entry.bytes;
+        // The picture after us was linked to our predecessor, which is no longer adjacent
+        if (next != entries.end()) next->second.linked = false;
+    }
+    haveLast = true;
+    lastInsertPts = pts;
+    evictLocked();
+}
+
+void FrameCache::setPlayhead(double pts) {
+    std::lock_guard<std::mutex> lock(mutex);
+    playhead = pts;
+}
+
+void FrameCache::eraseLocked(std::map<double, Entry>::iterator it) {
+    if (haveLast && it->first == lastInsertPts) haveLast = false;
+    auto next = std::next(it);
+    if (next != entries.end()) next->second.linked = false;
+    byteSize -= it->second.bytes;
+    av_frame_free(&it->second.frame);
+    entries.erase(it);
+}
+
+// Trim whichever end of the cached range lies farther from the playhead
+void FrameCache::evictLocked() {
+    while (byteSize > maxBytes && !entries.empty()) {
+        auto first = entries.begin();
+        auto last = std::prev(entries.end());
+        if (playhead - first->first >= last->first - playhead) eraseLocked(first);
+        else eraseLocked(last);
+    }
+}
+
+bool FrameCache::findRun(double time, double* start, double* end) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.upper_bound(time);
+    if (it == entries.begin()) return false;
+    --it;
+    // The picture must still be on screen at time (unknown durations get a generous frame)
+    double duration = it->second.duration > 0.0 ? it->second.duration : 0.1;
+    if (time >= it->first + duration) return false;
+
+    *start = it->first;
+    for (auto next = std::next(it); next != entries.end() && next->second.linked; ++next) {
+        it = next;
+    }
+    *end = it->first;
+    return true;
+}
+
+bool FrameCache::fetch(double pts, AVFrame* dst, double* duration) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(pts);
+    if (it == entries.end() || av_frame_ref(dst, it->second.frame) < 0) return false;
+    *duration = it->second.duration;
+    return true;
+}
+
+bool FrameCache::fetchNext(double after, AVFrame* dst, double* pts, double* duration) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.upper_bound(after);
+    // Only continue through a link: an unlinked picture means something is missing in between
+    if (it == entries.end() || !it->second.linked) return false;
+    if (entries.find(after) == entries.end()) return false;
+    if (av_frame_ref(dst, it->second.frame) < 0) return false;
+    *pts = it->first;
+    *duration = it->second.duration;
+    return true;
+}
+
+// The picture decoded right before the cached picture at `before` (frame stepping backwards)
+bool FrameCache::fetchPrevious(double before, AVFrame* dst, double* pts, double* duration) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(before);
+    if (it == entries.end() || !it->second.linked || it == entries.begin()) return false;
+    --it;
+    if (av_frame_ref(dst, it->second.frame) < 0) return false;
+    *pts = it->first;
+    *duration = it->second.duration;
+    return true;
+}
+
+size_t FrameCache::getByteSize() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return byteSize;
+}
+
+size_t FrameCache::getCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+
+extern "C"{
+    #include <libavutil/frame.h>
+}
+
+// Recently decoded pictures, kept as references to the decoder's own (native YUV) buffers and
+// keyed by pts, so a short jump backwards can be replayed from memory instead of re-decoded.
+// Pictures the decoder delivered back to back are linked; only linked spans are replayable.
+// When the byte budget is exceeded the picture farthest from the playhead goes first.
+class FrameCache
+{
+private:
+    struct Entry {
+        AVFrame* frame = nullptr;
+        double duration = 0.0;
+        size_t bytes = 0;
+        bool linked = false;   // directly follows the previous entry in decode order
+    };
+
+    std::map<double, Entry> entries;
+    mutable std::mutex mutex;
+    size_t maxBytes;
+    size_t byteSize = 0;
+    double playhead = 0.0;
+    bool haveLast = false;
+    double lastInsertPts = 0.0;
+
+    void evictLocked();
+    void eraseLocked(std::map<double, Entry>::iterator it);
+
+public:
+    explicit FrameCache(size_t maxBytes);
+    ~FrameCache();
+
+    void setBudget(size_t bytes);   // 0 disables the cache
+    void clear();
+
+    // Keep a reference to a decoded picture. continues: it is the picture the decoder
+    // delivered right after the previously inserted one.
+    void insert(const AVFrame* frame, double pts, double duration, bool continues);
+    // Eviction keeps the pictures around this position
+    void setPlayhead(double pts);
+
+    // Linked span that covers time: start is the picture showing at time, end the last linked one
+    bool findRun(double time, double* start, double* end) const;
+    // New references to cached pictures (dst must be blank)
+    bool fetch(double pts, AVFrame* dst, double* duration) const;
+    bool fetchNext(double after, AVFrame* dst, double* pts, double* duration) const;
+    bool fetchPrevious(double before, AVFrame* dst, double* pts, double* duration) const;
+
+    size_t getByteSize() const;
+    size_t getCount() const;
+};
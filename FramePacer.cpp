@@ -0,0 +1,124 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "Clock.h"
+
+
+void FramePacer::init(SDL_Window* window, SDL_Renderer* renderer) {
+    SDL_RendererInfo info;
+    bool vsync = SDL_GetRendererInfo(renderer, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC);
+    mode = vsync ? Mode::VSync : Mode::Timer;
+    stats = Stats();
+    stats.mode = vsync ? "vsync" : "timer";
+    lastPresent = lastPicture = 0.0;
+    earlyPresents = 0;
+    updateRefresh(window);
+}
+
+void FramePacer::updateRefresh(SDL_Window* window) {
+    SDL_DisplayMode displayMode;
+    int display = SDL_GetWindowDisplayIndex(window);
+    // Unknown refresh (some drivers report 0): assume 60 Hz, the presents correct it under vsync
+    if (display >= 0 && SDL_GetCurrentDisplayMode(display, &displayMode) == 0 && displayMode.refresh_rate > 0) {
+        refreshInterval = 1.0 / displayMode.refresh_rate;
+    }
+    stats.refreshHz = 1.0 / refreshInterval;
+}
+
+// First vsync at or after time, on the grid through the last present
+double FramePacer::nextVsyncAfter(double time) const {
+    if (lastPresent <= 0.0 || time <= lastPresent) return time;
+    double slots = std::ceil((time - lastPresent) / refreshInterval);
+    return lastPresent + slots * refreshInterval;
+}
+
+double FramePacer::beginFrame() {
+    frameStartedAt = Clock::now();
+    // The frame cannot go out before it is drawn: aim at the first vsync after that
+    targetVsync = nextVsyncAfter(frameStartedAt + renderCost);
+    return targetVsync - frameStartedAt;
+}
+
+double FramePacer::getRefreshInterval() const {
+    return refreshInterval;
+}
+
+void FramePacer::waitForPresent() {
+    double now = Clock::now();
+    renderCost = renderCost * 0.9 + (now - frameStartedAt) * 0.1;
+    if (mode != Mode::Timer || lastPresent <= 0.0) return;
+
+    // Late already: present right away, the grid re-aligns on this present
+    double remaining = targetVsync - now;
+    if (remaining <= 0.0) return;
+    // Sleep the coarse part (SDL_Delay is only millisecond accurate), spin the rest
+    if (remaining > kMaxTimerSpin) SDL_Delay(static_cast<Uint32>((remaining - kMaxTimerSpin) * 1000.0));
+    while (Clock::now() < targetVsync) {}
+}
+
+void FramePacer::presented(bool newPicture, double frameInterval) {
+    double now = Clock::now();
+    bool playing = frameInterval > 0.0;
+    stats.presents++;
+
+    if (lastPresent > 0.0) {
+        double interval = now - lastPresent;
+        if (playing && now - targetVsync > refreshInterval * 0.5) stats.missedVsyncs++;
+
+        if (mode == Mode::VSync && interval < refreshInterval * 0.5) {
+            // A vsync present cannot return twice within one refresh: the driver ignores the flag
+            if (++earlyPresents >= kVsyncViolations) {
+                std::cerr << "VSync is not honoured by the driver, pacing presents with a timer\n";
+                mode = Mode::Timer;
+                stats.mode = "timer";
+            }
+        }
+
+        // Idle gaps say nothing about pacing: only look at presents a few vsyncs apart
+        if (interval < refreshInterval * 4.0) {
+            double vsyncs = std::max(1.0, std::round(interval / refreshInterval));
+            stats.jitterMs = stats.jitterMs * 0.95 + std::fabs(interval - vsyncs * refreshInterval) * 1000.0 * 0.05;
+            if (vsyncs == 1.0) {
+                stats.avgIntervalMs = stats.avgIntervalMs > 0.0
+                    ? stats.avgIntervalMs * 0.95 + interval * 1000.0 * 0.05 : interval * 1000.0;
+                // The display mode rounds (59.94 Hz reads as 60): follow what vsync really does
+                if (mode == Mode::VSync && std::fabs(interval - refreshInterval) < refreshInterval * 0.1) {
+                    refreshInterval = refreshInterval * 0.99 + interval * 0.01;
+                    stats.refreshHz = 1.0 / refreshInterval;
+                }
+            }
+        }
+        if (playing && lastPicture > 0.0) stats.maxIntervalMs = std::max(stats.maxIntervalMs, interval * 1000.0);
+    }
+
+    // Cadence: 24 fps on 60 Hz alternates 2 and 3 vsyncs per picture, anything else is judder
+    if (!playing) {
+        lastPicture = 0.0;
+    } else if (newPicture) {
+        if (lastPicture > 0.0) {
+            double hold = std::max(1.0, std::round((now - lastPicture) / refreshInterval));
+            double expected = frameInterval / refreshInterval;
+            stats.avgHold = stats.avgHold > 0.0 ? stats.avgHold * 0.95 + hold * 0.05 : hold;
+            stats.expectedHold = expected;
+            if (hold < std::max(1.0, std::floor(expected)) || hold > std::max(1.0, std::ceil(expected))) {
+                stats.cadenceBreaks++;
+            }
+        }
+        lastPicture = now;
+    }
+
+    // In timer mode the grid stays where it was as long as the slot was hit
+    bool onGrid = mode == Mode::Timer && std::fabs(now - targetVsync) < kMaxTimerSpin;
+    lastPresent = onGrid ? targetVsync : now;
+}
+
+FramePacer::Mode FramePacer::getMode() const {
+    return mode;
+}
+
+FramePacer::Stats FramePacer::getStats() const {
+    return stats;
+}
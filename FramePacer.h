@@ -0,0 +1,62 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+
+// Locks presentation to the display refresh. With a vsync renderer SDL_RenderPresent returns
+// right after the vblank it went out on, which gives the phase of the vsync grid; the pacer
+// predicts the vsync the frame being drawn will land on, so the player can pick the picture
+// meant for that moment instead of the one due right now. When the driver does not honour
+// vsync (or the renderer could not be created with it) the pacer waits for the next slot of
+// the same grid itself with a high-resolution timer. Present-to-present intervals and how long
+// each video picture stayed up are measured for the judder statistics.
+class FramePacer
+{
+public:
+    enum class Mode { VSync, Timer };
+
+    struct Stats {
+        const char* mode = "timer";
+        double refreshHz = 0.0;        // measured (display mode until enough presents were seen)
+        long presents = 0;
+        double avgIntervalMs = 0.0;    // present to present, while presenting back to back
+        double jitterMs = 0.0;         // average distance of an interval from a whole number of vsyncs
+        double maxIntervalMs = 0.0;
+        long missedVsyncs = 0;         // presents that went out later than the vsync they were drawn for
+        double avgHold = 0.0;          // vsyncs each video picture stayed on screen
+        double expectedHold = 0.0;     // ...and what the frame rate asks for
+        long cadenceBreaks = 0;        // pictures held outside floor/ceil of the expected hold
+    };
+
+private:
+    static constexpr double kMaxTimerSpin = 0.002;    // busy-wait at most this long before a timer present
+    static constexpr int kVsyncViolations = 8;        // early presents before vsync is considered ignored
+
+    Mode mode = Mode::Timer;
+    double refreshInterval = 1.0 / 60.0;
+    double lastPresent = 0.0;      // a point of the vsync grid (0 before the first present)
+    double targetVsync = 0.0;      // vsync the frame being drawn is meant for
+    double lastPicture = 0.0;      // present that carried the last new video picture
+    double renderCost = 0.0;       // smoothed time from beginFrame() to the present
+    double frameStartedAt = 0.0;
+    int earlyPresents = 0;
+    Stats stats;
+
+    double nextVsyncAfter(double time) const;
+
+public:
+    // Read the refresh rate of the display the window is on and whether the renderer has vsync
+    void init(SDL_Window* window, SDL_Renderer* renderer);
+    void updateRefresh(SDL_Window* window);   // window moved to another display
+
+    // Start of a frame: seconds from now until the vsync its present will land on
+    double beginFrame();
+    double getRefreshInterval() const;
+    // Call right before SDL_RenderPresent: in timer mode sleeps until the target vsync
+    void waitForPresent();
+    // Right after SDL_RenderPresent. newPicture: a new video picture went up with it;
+    // frameInterval: wall seconds per video picture at the current speed (for the cadence)
+    void presented(bool newPicture, double frameInterval);
+
+    Mode getMode() const;
+    Stats getStats() const;
+};
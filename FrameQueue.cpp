@@ -0,0 +1,76 @@
+#include "FrameQueue.h"
+
+
+FrameQueue::FrameQueue(int depth) : slots(depth) {
+    for (Frame& slot : slots) {
+        slot.frame = av_frame_alloc();
+    }
+}
+
+FrameQueue::~FrameQueue() {
+    for (Frame& slot : slots) {
+        av_frame_free(&slot.frame);
+    }
+}
+
+FrameQueue::Frame* FrameQueue::peekWritable() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [this] { return aborted || count < static_cast<int>(slots.size()); });
+    if (aborted) return nullptr;
+    return &slots[writeIndex];
+}
+
+void FrameQueue::push() {
+    std::lock_guard<std::mutex> lock(mutex);
+    writeIndex = (writeIndex + 1) % slots.size();
+    count++;
+    cond.notify_all();
+}
+
+FrameQueue::Frame* FrameQueue::peekReadable() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0) return nullptr;
+    return &slots[readIndex];
+}
+
+// The picture after the current one (used to know when the current one stops being due)
+FrameQueue::Frame* FrameQueue::peekNextReadable() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count < 2) return nullptr;
+    return &slots[(readIndex + 1) % slots.size()];
+}
+
+void FrameQueue::next() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0) return;
+    readIndex = (readIndex + 1) % slots.size();
+    count--;
+    cond.notify_all();
+}
+
+void FrameQueue::abort() {
+    std::lock_guard<std::mutex> lock(mutex);
+    aborted = true;
+    cond.notify_all();
+}
+
+void FrameQueue::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    aborted = false;
+}
+
+void FrameQueue::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    readIndex = writeIndex;
+    count = 0;
+    cond.notify_all();
+}
+
+int FrameQueue::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return count;
+}
+
+int FrameQueue::capacity() const {
+    return static_cast<int>(slots.size());
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+extern "C"{
+    #include <libavutil/frame.h>
+}
+
+// Fixed-depth ring of decoded pictures between the video decode thread and the render thread.
+// Slots keep their AVFrame between uses so the writer can reuse already allocated buffers.
+class FrameQueue
+{
+public:
+    struct Frame {
+        AVFrame* frame = nullptr;
+        double pts = 0.0;       // presentation time in seconds
+        double duration = 0.0;  // display duration in seconds (0 when unknown)
+        int serial = 0;         // packet queue serial the picture was decoded from
+    };
+
+private:
+    std::vector<Frame> slots;
+    int readIndex = 0;
+    int writeIndex = 0;
+    int count = 0;
+    bool aborted = false;
+    std::mutex mutex;
+    std::condition_variable cond;
+
+public:
+    explicit FrameQueue(int depth);
+    ~FrameQueue();
+
+    // Writer side: wait for a free slot (nullptr on abort), fill it, then push()
+    Frame* peekWritable();
+    void push();
+
+    // Reader side: never blocks, nullptr when nothing is queued
+    Frame* peekReadable();
+    Frame* peekNextReadable();
+    void next();
+
+    void abort();
+    void start();
+    void clear();   // forget all queued pictures (slot buffers are kept)
+    int size();
+    int capacity() const;
+};
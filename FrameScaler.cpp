@@ -0,0 +1,143 @@
+#include "FrameScaler.h"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+extern "C"{
+    #include <libavutil/opt.h>
+}
+
+
+const char* scaleAlgorithmName(ScaleAlgorithm algorithm) {
+    switch (algorithm) {
+        case ScaleAlgorithm::FastBilinear: return "fast-bilinear";
+        case ScaleAlgorithm::Bilinear: return "bilinear";
+        case ScaleAlgorithm::Bicubic: return "bicubic";
+        case ScaleAlgorithm::Lanczos: return "lanczos";
+        case ScaleAlgorithm::Area: return "area";
+    }
+    return "bilinear";
+}
+
+bool parseScaleAlgorithm(const std::string& name, ScaleAlgorithm* algorithm) {
+    for (ScaleAlgorithm candidate : {ScaleAlgorithm::FastBilinear, ScaleAlgorithm::Bilinear,
+                                     ScaleAlgorithm::Bicubic, ScaleAlgorithm::Lanczos, ScaleAlgorithm::Area}) {
+        if (name == scaleAlgorithmName(candidate)) {
+            *algorithm = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool scaleToBox(int srcWidth, int srcHeight, int boxWidth, int boxHeight, bool uploadable, int* w, int* h) {
+    *w = srcWidth;
+    *h = srcHeight;
+    if (boxWidth <= 0 || boxHeight <= 0) return false;
+    int targetWidth = std::min(srcWidth, boxWidth);
+    int targetHeight = std::min(srcHeight, boxHeight);
+    if (targetWidth >= srcWidth && targetHeight >= srcHeight) return false;
+    if (uploadable && static_cast<int64_t>(targetWidth) * targetHeight * 2 > static_cast<int64_t>(srcWidth) * srcHeight) {
+        return false;
+    }
+    *w = targetWidth;
+    *h = targetHeight;
+    return true;
+}
+
+static int swsFlags(ScaleAlgorithm algorithm) {
+    switch (algorithm) {
+        case ScaleAlgorithm::FastBilinear: return SWS_FAST_BILINEAR;
+        case ScaleAlgorithm::Bilinear: return SWS_BILINEAR;
+        case ScaleAlgorithm::Bicubic: return SWS_BICUBIC;
+        case ScaleAlgorithm::Lanczos: return SWS_LANCZOS;
+        case ScaleAlgorithm::Area: return SWS_AREA;
+    }
+    return SWS_BILINEAR;
+}
+
+
+FrameScaler::~FrameScaler() {
+    reset();
+}
+
+void FrameScaler::reset() {
+    if (ctx) sws_freeContext(ctx);
+    ctx = nullptr;
+    activeThreads = 0;
+}
+
+void FrameScaler::setThreads(int count) {
+    threads = std::max(0, count);
+}
+
+int FrameScaler::getActiveThreads() const {
+    return activeThreads;
+}
+
+// (Re)build the context when anything it was made for changes, e.g. a mid-stream size change
+bool FrameScaler::ensureContext(const AVFrame* src, AVPixelFormat format, int w, int h, int swsFlags) {
+    int count = threads;
+    if (count == 0) {
+        // One thread per core, capped, and none for pictures too small to be worth splitting
+        int pixels = std::max(src->width * src->height, w * h);
+        count = static_cast<int>(std::thread::hardware_concurrency());
+        if (count <= 0) count = 1;
+        count = std::min(count, kMaxAutoScaleThreads);
+        if (pixels < kThreadedScaleMinPixels) count = 1;
+    }
+    if (ctx && src->width == srcWidth && src->height == srcHeight && src->format == srcFormat &&
+        w == dstWidth && h == dstHeight && format == dstFormat && swsFlags == flags && count == activeThreads) {
+        return true;
+    }
+    reset();
+    ctx = sws_alloc_context();
+    if (!ctx) return false;
+    av_opt_set_int(ctx, "srcw", src->width, 0);
+    av_opt_set_int(ctx, "srch", src->height, 0);
+    av_opt_set_int(ctx, "src_format", src->format, 0);
+    av_opt_set_int(ctx, "dstw", w, 0);
+    av_opt_set_int(ctx, "dsth", h, 0);
+    av_opt_set_int(ctx, "dst_format", format, 0);
+    av_opt_set_int(ctx, "sws_flags", swsFlags, 0);
+    av_opt_set_int(ctx, "threads", count, 0);
+    if (sws_init_context(ctx, nullptr, nullptr) < 0) {
+        sws_freeContext(ctx);
+        ctx = nullptr;
+        return false;
+    }
+    srcWidth = src->width;
+    srcHeight = src->height;
+    srcFormat = src->format;
+    dstWidth = w;
+    dstHeight = h;
+    dstFormat = format;
+    flags = swsFlags;
+    activeThreads = count;
+    return true;
+}
+
+bool FrameScaler::scale(const AVFrame* src, AVFrame* dst, AVPixelFormat format, int w, int h, ScaleAlgorithm algorithm) {
+    // A slot that last held a decoder or frame cache picture by reference must not be written into
+    if (dst->format != format || dst->width != w || dst->height != h || !dst->buf[0] || !av_frame_is_writable(dst)) {
+        av_frame_unref(dst);
+        dst->format = format;
+        dst->width = w;
+        dst->height = h;
+        if (av_frame_get_buffer(dst, 0) < 0) {
+            std::cerr << "Failed to allocate video frame buffer\n";
+            return false;
+        }
+    }
+    if (!ensureContext(src, format, w, h, swsFlags(algorithm))) {
+        std::cerr << "Unsupported pixel format for conversion\n";
+        return false;
+    }
+    // Unlike sws_scale, the frame API hands the output bands to the slice threads
+    if (sws_scale_frame(ctx, dst, src) < 0) {
+        std::cerr << "Failed to convert video frame\n";
+        return false;
+    }
+    return true;
+}
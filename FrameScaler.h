@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+extern "C"{
+    #include <libavutil/frame.h>
+    #include <libswscale/swscale.h>
+}
+
+// swscale filter used when a picture is resized, fastest first
+enum class ScaleAlgorithm {
+    FastBilinear,
+    Bilinear,
+    Bicubic,
+    Lanczos,
+    Area      // averages source pixels: good for large downscales
+};
+
+const char* scaleAlgorithmName(ScaleAlgorithm algorithm);
+bool parseScaleAlgorithm(const std::string& name, ScaleAlgorithm* algorithm);
+
+// Slice threads are only worth their wake-ups on large pictures
+static const int kMaxAutoScaleThreads = 8;
+static const int kThreadedScaleMinPixels = 1280 * 720;
+// Display boxes round up to this, so a window drag reuses the context
+static const int kScaleAlign = 8;
+
+// Size a srcWidth x srcHeight picture is converted at for a boxWidth x boxHeight display
+// rectangle: the box when that is smaller than the picture (SDL still does any enlarging, on
+// the GPU). A picture the texture could take without conversion (uploadable) only gets a
+// swscale pass when it at least halves the upload. False: keep the picture at its own size.
+bool scaleToBox(int srcWidth, int srcHeight, int boxWidth, int boxHeight, bool uploadable, int* w, int* h);
+
+// One swscale conversion: pixel format and size of the output are chosen per call, the
+// context is kept across calls (rebuilt only when the source, the target, the algorithm or
+// the thread count changes). Large pictures are converted by swscale's slice threads: the
+// output is split into horizontal bands that a pool of workers scales in parallel
+// (sws_scale_frame, FFmpeg 5.0+). Not thread-safe: one instance per calling thread.
+class FrameScaler
+{
+private:
+    SwsContext* ctx = nullptr;
+    // What ctx was built for (sws_getCachedContext cannot set a thread count)
+    int srcWidth = 0, srcHeight = 0, srcFormat = -1;
+    int dstWidth = 0, dstHeight = 0, dstFormat = -1;
+    int flags = 0;
+    int threads = 0;          // requested: 0 auto, 1 single-threaded
+    std::atomic<int> activeThreads{0};  // what ctx runs with (may be read from another thread for stats)
+
+    bool ensureContext(const AVFrame* src, AVPixelFormat format, int w, int h, int swsFlags);
+
+public:
+    FrameScaler() = default;
+    FrameScaler(const FrameScaler&) = delete;
+    FrameScaler& operator=(const FrameScaler&) = delete;
+    ~FrameScaler();
+
+    // Convert src into dst at w x h in format. dst keeps its buffer while format and size stay
+    // the same (and nobody else references it), so a queue slot does not reallocate per picture.
+    bool scale(const AVFrame* src, AVFrame* dst, AVPixelFormat format, int w, int h, ScaleAlgorithm algorithm);
+    void reset();
+
+    // Slice threads for the next conversions: 0 picks from the cores and the picture size
+    void setThreads(int count);
+    int getActiveThreads() const;   // 0 before the first conversion
+};
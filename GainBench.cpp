@@ -0,0 +1,83 @@
+// Microbenchmark for the audio gain kernels: runs every kernel the CPU supports over a
+// device-sized buffer and prints throughput, plus a check that each one matches the scalar path.
+#include "AudioGain.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static const size_t kSamples = 2048 * 8;   // one 2048-frame callback buffer of 7.1 audio
+static const int kIterations = 20000;
+
+template <typename T>
+static double copyNs(std::vector<T>& buffer, const std::vector<T>& source) {
+    volatile T sink = T();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; i++) {
+        buffer = source;
+        sink = buffer[i % kSamples];
+    }
+    auto end = std::chrono::steady_clock::now();
+    (void)sink;
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+template <typename T, typename Fn>
+static double nsPerSample(Fn fn, std::vector<T>& buffer, const std::vector<T>& source) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; i++) {
+        buffer = source; // fresh input every pass so s16 does not saturate and floats stay finite
+        // Alternate ramp directions so both the ramp and the constant-gain case are exercised
+        float from = (i & 1) ? 0.5f : 1.5f;
+        fn(buffer.data(), buffer.size(), from, (i & 2) ? from : 2.0f - from);
+    }
+    auto end = std::chrono::steady_clock::now();
+    // The refill is not part of the kernel: time it on its own and take it off
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() - copyNs(buffer, source);
+    if (ns < 0.0) ns = 0.0;
+    return ns / (double(kIterations) * kSamples);
+}
+
+int main() {
+    std::vector<float> floatSource(kSamples);
+    std::vector<int16_t> s16Source(kSamples);
+    srand(1);
+    for (size_t i = 0; i < kSamples; i++) {
+        floatSource[i] = (rand() / (float)RAND_MAX) * 2.0f - 1.0f;
+        s16Source[i] = static_cast<int16_t>(rand() % 65536 - 32768);
+    }
+
+    std::vector<GainKernels> kernels = availableGainKernels();
+    std::vector<float> floatRef = floatSource, floatOut;
+    std::vector<int16_t> s16Ref = s16Source, s16Out;
+    kernels[0].applyFloat(floatRef.data(), kSamples, 0.25f, 2.0f);
+    kernels[0].applyS16(s16Ref.data(), kSamples, 0.25f, 2.0f);
+
+    printf("active kernel: %s\n", activeGainKernels().name);
+    printf("%-8s %14s %14s %10s\n", "kernel", "float ns/smp", "s16 ns/smp", "matches");
+    double scalarFloat = 0.0, scalarS16 = 0.0;
+    for (const GainKernels& k : kernels) {
+        // Correctness against the scalar reference (ramp accumulation may differ in the last bits)
+        floatOut = floatSource;
+        s16Out = s16Source;
+        k.applyFloat(floatOut.data(), kSamples, 0.25f, 2.0f);
+        k.applyS16(s16Out.data(), kSamples, 0.25f, 2.0f);
+        bool ok = true;
+        for (size_t i = 0; i < kSamples && ok; i++) {
+            float diff = floatOut[i] - floatRef[i];
+            if (diff > 1e-4f || diff < -1e-4f) ok = false;
+            if (std::abs(s16Out[i] - s16Ref[i]) > 1) ok = false;
+        }
+
+        std::vector<float> floatBuf;
+        std::vector<int16_t> s16Buf;
+        double f = nsPerSample(k.applyFloat, floatBuf, floatSource);
+        double s = nsPerSample(k.applyS16, s16Buf, s16Source);
+        if (scalarFloat == 0.0) { scalarFloat = f; scalarS16 = s; }
+        printf("%-8s %8.3f (%4.1fx) %8.3f (%4.1fx) %10s\n", k.name,
+               f, scalarFloat / f, s, scalarS16 / s, ok ? "yes" : "NO");
+        if (!ok) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include "InputOpener.h"
+
+#include <iostream>
+
+
+bool openInput(const std::string& path, const InputOptions& options, MmapIO* mmapIO, PrefetchIO* prefetchIO,
+               const StreamInfoCache& streamInfoCache, AVFormatContext** fmtCtx, const char** streamInfo) {
+    // Local files can be read straight out of a memory mapping, or through the read-ahead
+    // prefetcher on slow storage (anything else goes through FFmpeg's own I/O)
+    AVFormatContext* ctx = avformat_alloc_context();
+    *fmtCtx = nullptr;
+    if (!ctx) return false;
+    AVIOContext* customIO = nullptr;
+    if (options.mmapIO && mmapIO->open(path)) {
+        customIO = mmapIO->getContext();
+    } else if (options.prefetchBytes > 0 && prefetchIO->open(path, options.prefetchBytes)) {
+        customIO = prefetchIO->getContext();
+    }
+    if (customIO) {
+        ctx->pb = customIO;
+        ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
+    // Fast open: stop probing early (also bounds the stream info pass below)
+    AVDictionary* openOptions = nullptr;
+    if (options.fastOpen) {
+        av_dict_set_int(&openOptions, "probesize", options.probeSize, 0);
+        av_dict_set_int(&openOptions, "analyzeduration", options.analyzeDuration, 0);
+    }
+    // Open the media file (all formats, let ffmpeg auto-detect container)
+    int opened = avformat_open_input(&ctx, path.c_str(), nullptr, &openOptions);
+    av_dict_free(&openOptions);
+    if (opened != 0) {
+        std::cerr << "Failed to open input file\n";
+        return false;
+    }
+
+    // Known file: its stream parameters come from the cache and nothing has to be probed
+    if (options.streamInfoCache && streamInfoCache.apply(ctx, path, options.fastOpen)) {
+        *streamInfo = "cache";
+    } else {
+        // Scan for all stream info (finds audio, video, subtitle, etc.)
+        if (avformat_find_stream_info(ctx, nullptr) < 0) {
+            std::cerr << "Failed to find stream info\n";
+            avformat_close_input(&ctx);
+            return false;
+        }
+        *streamInfo = options.fastOpen ? "fast probe" : "probe";
+        // Tagged with the probe mode: a bounded probe's entry never serves a full-probe open
+        if (options.streamInfoCache) streamInfoCache.store(ctx, path, options.fastOpen);
+    }
+    *fmtCtx = ctx;
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "MmapIO.h"
+#include "PrefetchIO.h"
+#include "StreamInfoCache.h"
+
+extern "C"{
+    #include <libavformat/avformat.h>
+}
+
+// Opening: bounded probing in fast-open mode, no probing at all for files seen before
+static const int64_t kFastProbeSize = 512 * 1024;       // bytes (FFmpeg default: 5 MB)
+static const int64_t kFastAnalyzeDuration = 500000;     // us (FFmpeg default: 5 s)
+
+// How a media file is read and probed
+struct InputOptions {
+    bool mmapIO = false;   // read local files through a memory mapping instead of read()
+    size_t prefetchBytes = 0; // read this far ahead of the demuxer asynchronously (0: off)
+    bool fastOpen = false;    // probe with the limits below instead of FFmpeg's defaults
+    int64_t probeSize = kFastProbeSize;
+    int64_t analyzeDuration = kFastAnalyzeDuration;
+    bool streamInfoCache = false; // reuse the stream parameters of files opened before (writes ~/.cache)
+};
+
+// Open path into *fmtCtx and get its stream parameters, the way the player does it: through
+// mmapIO or prefetchIO when the options ask for them (FFmpeg's own I/O when they are off or
+// the file cannot be mapped/opened), then from the stream info cache or by probing.
+// mmapIO and prefetchIO back the context's I/O and must outlive it. streamInfo tells where
+// the parameters came from ("probe", "fast probe" or "cache"). On failure *fmtCtx is null.
+bool openInput(const std::string& path, const InputOptions& options, MmapIO* mmapIO, PrefetchIO* prefetchIO,
+               const StreamInfoCache& streamInfoCache, AVFormatContext** fmtCtx, const char** streamInfo);
@@ -0,0 +1,158 @@
+#include "KeyframeIndex.h"
+
+#include <algorithm>
+#include <iostream>
+
+
+// Container indexes that stop this far before the end were built on the fly while reading
+static const double kIndexCoverage = 0.9;
+
+KeyframeIndex::~KeyframeIndex() {
+    clear();
+}
+
+void KeyframeIndex::build(AVFormatContext* fmtCtx, int streamIndex, const std::string& path, const InputOptions& input) {
+    clear();
+    if (loadFromStream(fmtCtx, streamIndex)) return;
+    // No usable index (raw TS/ES, fragmented files...): read the packets ourselves on a
+    // separate context so the demux thread is not disturbed
+    scanAbort = false;
+    scanThread = std::thread(&KeyframeIndex::scanLoop, this, path, streamIndex, input);
+}
+
+void KeyframeIndex::clear() {
+    scanAbort = true;
+    if (scanThread.joinable()) scanThread.join();
+    std::lock_guard<std::mutex> lock(mutex);
+    keyframes.clear();
+    source = Source::None;
+    scannedUntil = -1.0;
+    complete = false;
+    calibrated = false;
+}
+
+bool KeyframeIndex::loadFromStream(AVFormatContext* fmtCtx, int streamIndex) {
+    AVStream* stream = fmtCtx->streams[streamIndex];
+    std::vector<Keyframe> found;
+    int count = avformat_index_get_entries_count(stream);
+    for (int i = 0; i < count; i++) {
+        const AVIndexEntry* entry = avformat_index_get_entry(stream, i);
+        if (!entry || !(entry->flags & AVINDEX_KEYFRAME)) continue;
+        Keyframe kf;
+        kf.timestamp = entry->timestamp;
+        kf.pos = entry->pos;
+        kf.time = entry->timestamp * av_q2d(stream->time_base);
+        found.push_back(kf);
+    }
+    if (found.empty()) return false;
+    std::sort(found.begin(), found.end(), [](const Keyframe& a, const Keyframe& b) { return a.time < b.time; });
+
+    // Only trust it when it reaches (close to) the end of the file
+    double duration = fmtCtx->duration != AV_NOPTS_VALUE ? fmtCtx->duration / (double)AV_TIME_BASE : 0.0;
+    if (duration > 0.0 && found.back().time < duration * kIndexCoverage) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    keyframes = std::move(found);
+    source = Source::Container;
+    timeBase = stream->time_base;
+    complete = true;
+    return true;
+}
+
+void KeyframeIndex::notePacket(const AVPacket* pkt) {
+    if (calibrated || pkt->pts == AV_NOPTS_VALUE || pkt->pos < 0) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    // The scan records pts itself; nothing to learn before the container index is loaded
+    if (source != Source::Container) return;
+    for (const Keyframe& kf : keyframes) {
+        if (kf.pos != pkt->pos) continue;
+        // Keyframes share one reorder delay: shift every entry by the offset of this one
+        double offset = (pkt->pts - kf.timestamp) * av_q2d(timeBase);
+        for (Keyframe& entry : keyframes) entry.time += offset;
+        calibrated = true;
+        return;
+    }
+}
+
+// Background scan: demux (never decode) the whole file and remember every video keyframe
+void KeyframeIndex::scanLoop(std::string path, int streamIndex, InputOptions input) {
+    // Same bounded probing, stream info cache and I/O path as playback: the player's open has
+    // usually just cached the stream info, and a whole-file read is what the prefetcher is for
+    AVFormatContext* scanCtx = nullptr;
+    const char* streamInfo = nullptr;
+    if (!openInput(path, input, &scanMmapIO, &scanPrefetchIO, streamInfoCache, &scanCtx, &streamInfo)) {
+        std::cerr << "Keyframe scan: failed to open input file\n";
+        scanMmapIO.close();
+        scanPrefetchIO.close();
+        return;
+    }
+    if (streamIndex >= (int)scanCtx->nb_streams) {
+        std::cerr << "Keyframe scan: video stream not found\n";
+        avformat_close_input(&scanCtx);
+        scanMmapIO.close();
+        scanPrefetchIO.close();
+        return;
+    }
+    // Let the demuxer throw away every other stream as early as it can
+    for (unsigned i = 0; i < scanCtx->nb_streams; i++) {
+        if ((int)i != streamIndex) scanCtx->streams[i]->discard = AVDISCARD_ALL;
+    }
+    AVRational timeBase = scanCtx->streams[streamIndex]->time_base;
+
+    AVPacket* pkt = av_packet_alloc();
+    while (!scanAbort && av_read_frame(scanCtx, pkt) >= 0) {
+        if (pkt->stream_index == streamIndex) {
+            int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            if (ts != AV_NOPTS_VALUE) {
+                double time = ts * av_q2d(timeBase);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (pkt->flags & AV_PKT_FLAG_KEY) {
+                    Keyframe kf;
+                    kf.timestamp = ts;
+                    kf.pos = pkt->pos;
+                    kf.time = time;
+                    // Packets come in decode order; keyframes are almost always in pts order too
+                    auto at = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+                        [](double t, const Keyframe& k) { return t < k.time; });
+                    keyframes.insert(at, kf);
+                    source = Source::Scan;
+                }
+                if (time > scannedUntil) scannedUntil = time;
+            }
+        }
+        av_packet_unref(pkt);
+    }
+    if (!scanAbort) complete = true;
+    av_packet_free(&pkt);
+    avformat_close_input(&scanCtx);
+    // The custom I/O outlives the context it backed
+    scanMmapIO.close();
+    scanPrefetchIO.close();
+}
+
+bool KeyframeIndex::find(double time, Keyframe* out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (keyframes.empty()) return false;
+    // A partial scan only knows the part of the file it has already read
+    if (!complete && time > scannedUntil) return false;
+    // Binary search: the first keyframe after time, then step back one
+    auto after = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+        [](double t, const Keyframe& k) { return t < k.time; });
+    if (after == keyframes.begin()) return false;
+    *out = *(after - 1);
+    return true;
+}
+
+KeyframeIndex::Source KeyframeIndex::getSource() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return source;
+}
+
+bool KeyframeIndex::isComplete() const {
+    return complete;
+}
+
+size_t KeyframeIndex::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return keyframes.size();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "InputOpener.h"
+
+extern "C"{
+    #include <libavformat/avformat.h>
+}
+
+// Sorted list of the video stream's keyframes, so a seek can land on the keyframe right
+// before the target instead of letting the demuxer search for one. Taken from the container's
+// own index when it has a complete one, otherwise built by a background scan of the file.
+// Times are presentation times. Some containers index decode timestamps (MP4/MOV), which sit
+// a reorder delay before the pts; the offset is learned from the first keyframe the demuxer
+// reads (notePacket).
+class KeyframeIndex
+{
+public:
+    struct Keyframe {
+        int64_t timestamp = AV_NOPTS_VALUE;  // what the demuxer seeks by (dts for MP4/MOV), time_base units
+        int64_t pos = -1;                    // byte offset of the packet, -1 when unknown
+        double time = 0.0;                   // presentation time in seconds
+    };
+
+    enum class Source {
+        None,       // nothing usable (yet)
+        Container,  // AVStream index entries
+        Scan        // packets read by the background scan
+    };
+
+private:
+    std::vector<Keyframe> keyframes;   // ordered by time
+    mutable std::mutex mutex;
+    Source source = Source::None;
+    double scannedUntil = -1.0;        // lookups past this point wait for the scan to get there
+    std::atomic<bool> complete{false};
+    AVRational timeBase = {1, AV_TIME_BASE};
+    std::atomic<bool> calibrated{false};  // container times are known to be pts
+    std::thread scanThread;
+    std::atomic<bool> scanAbort{false};
+    MmapIO scanMmapIO;                 // the scan's context reads like the player's (see openInput)
+    PrefetchIO scanPrefetchIO;
+    StreamInfoCache streamInfoCache;
+
+    bool loadFromStream(AVFormatContext* fmtCtx, int streamIndex);
+    void scanLoop(std::string path, int streamIndex, InputOptions input);
+
+public:
+    ~KeyframeIndex();
+
+    // Use the demuxer's index when it covers the whole stream, else start scanning path
+    // (opened with the same I/O path and probing as the player's own context)
+    void build(AVFormatContext* fmtCtx, int streamIndex, const std::string& path, const InputOptions& input);
+    void clear();   // stops a running scan and forgets everything
+
+    // Keyframe packets read by the demuxer: the first one that matches a container index entry
+    // gives the offset from the index's timestamps to pts (cheap no-op once that is known)
+    void notePacket(const AVPacket* pkt);
+
+    // Last keyframe at or before time (a pts in seconds); false when the index cannot answer (yet)
+    bool find(double time, Keyframe* out) const;
+
+    Source getSource() const;
+    bool isComplete() const;
+    size_t size() const;
+};
@@ -0,0 +1,136 @@
+#include "MmapIO.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C"{
+    #include <libavutil/error.h>
+    #include <libavutil/mem.h>
+}
+
+
+MmapIO::~MmapIO() {
+    close();
+}
+
+bool MmapIO::open(const std::string& path) {
+    close();
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    // Only regular, non-empty files can be mapped (pipes, devices and URLs use normal I/O)
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        close();
+        return false;
+    }
+    size = st.st_size;
+    void* mapped = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "mmap failed for " << path << ": " << std::strerror(errno) << std::endl;
+        data = nullptr;
+        close();
+        return false;
+    }
+    data = static_cast<uint8_t*>(mapped);
+
+    unsigned char* buffer = static_cast<unsigned char*>(av_malloc(kBufferSize));
+    if (buffer) avio = avio_alloc_context(buffer, kBufferSize, 0, this, &MmapIO::readPacket, nullptr, &MmapIO::seekPacket);
+    if (!avio) {
+        std::cerr << "Failed to allocate mmap I/O context\n";
+        av_free(buffer);
+        close();
+        return false;
+    }
+    pos = runStart = 0;
+    sequential = false;
+    advise(true); // opening a file for playback: start with aggressive readahead
+    reads = bytesRead = seeks = adviceChanges = 0;
+    return true;
+}
+
+void MmapIO::close() {
+    if (avio) {
+        av_freep(&avio->buffer); // avio_context_free leaves the buffer to its owner
+        avio_context_free(&avio);
+    }
+    if (data) munmap(data, static_cast<size_t>(size));
+    if (fd >= 0) ::close(fd);
+    data = nullptr;
+    fd = -1;
+    size = pos = 0;
+}
+
+bool MmapIO::isOpen() const {
+    return avio != nullptr;
+}
+
+AVIOContext* MmapIO::getContext() const {
+    return avio;
+}
+
+MmapIO::Stats MmapIO::getStats() const {
+    Stats stats;
+    stats.reads = reads;
+    stats.bytesRead = bytesRead;
+    stats.seeks = seeks;
+    stats.adviceChanges = adviceChanges;
+    return stats;
+}
+
+// Readahead for playback, none for jumping around (it would only pull in pages nobody reads)
+void MmapIO::advise(bool sequentialAccess) {
+    if (sequentialAccess == sequential) return;
+    sequential = sequentialAccess;
+    madvise(data, static_cast<size_t>(size), sequentialAccess ? MADV_SEQUENTIAL : MADV_RANDOM);
+    adviceChanges++;
+}
+
+int MmapIO::readPacket(void* opaque, uint8_t* buf, int bufSize) {
+    MmapIO* io = static_cast<MmapIO*>(opaque);
+    if (io->pos >= io->size) return AVERROR_EOF;
+    int64_t count = std::min<int64_t>(bufSize, io->size - io->pos);
+    // A file truncated under the mapping would raise SIGBUS here; media files are not
+    // expected to shrink while they play
+    std::memcpy(buf, io->data + io->pos, static_cast<size_t>(count));
+    io->pos += count;
+    io->reads++;
+    io->bytesRead += count;
+    // Back to contiguous reading after a jump: let the kernel read ahead again
+    if (!io->sequential && io->pos - io->runStart >= kSequentialRun) io->advise(true);
+    return static_cast<int>(count);
+}
+
+int64_t MmapIO::seekPacket(void* opaque, int64_t offset, int whence) {
+    MmapIO* io = static_cast<MmapIO*>(opaque);
+    whence &= ~AVSEEK_FORCE;
+    if (whence == AVSEEK_SIZE) return io->size;
+
+    int64_t target;
+    if (whence == SEEK_SET) target = offset;
+    else if (whence == SEEK_CUR) target = io->pos + offset;
+    else if (whence == SEEK_END) target = io->size + offset;
+    else return AVERROR(EINVAL);
+    if (target < 0 || target > io->size) return AVERROR(EINVAL);
+
+    if (target != io->pos) {
+        io->seeks++;
+        // Small hops are the demuxer skipping around inside what it is reading anyway
+        if (std::llabs(target - io->pos) > kRandomJump) {
+            io->advise(false);
+            // The pages right at the new position are wanted no matter what
+            int64_t page = sysconf(_SC_PAGESIZE);
+            int64_t start = target / page * page;
+            madvise(io->data + start, static_cast<size_t>(std::min<int64_t>(kBufferSize, io->size - start)), MADV_WILLNEED);
+            io->runStart = target;
+        }
+        io->pos = target;
+    }
+    return target;
+}
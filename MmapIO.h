@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+extern "C"{
+    #include <libavformat/avio.h>
+}
+
+// AVIOContext over a read-only mmap of a local file. Reads are plain copies out of the page
+// cache instead of one read() syscall per AVIO buffer refill, and the kernel gets madvise
+// hints: sequential readahead during playback, random after a seek jumps far away (until the
+// reads have been contiguous for a while again). Used only by the thread that owns the
+// AVFormatContext; the counters may be read from anywhere.
+class MmapIO
+{
+public:
+    struct Stats {
+        uint64_t reads = 0;          // read callbacks served
+        uint64_t bytesRead = 0;
+        uint64_t seeks = 0;          // position changes (size queries not counted)
+        uint64_t adviceChanges = 0;  // madvise switches between sequential and random
+    };
+
+private:
+    static constexpr int kBufferSize = 256 * 1024;               // AVIO buffer per refill
+    static constexpr int64_t kRandomJump = 4 * 1024 * 1024;      // farther seeks count as random access
+    static constexpr int64_t kSequentialRun = 4 * 1024 * 1024;   // contiguous bytes before readahead again
+
+    int fd = -1;
+    uint8_t* data = nullptr;
+    int64_t size = 0;
+    int64_t pos = 0;
+    int64_t runStart = 0;        // where the current contiguous read run started
+    bool sequential = false;     // hint currently applied to the mapping
+    AVIOContext* avio = nullptr;
+
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> bytesRead{0};
+    std::atomic<uint64_t> seeks{0};
+    std::atomic<uint64_t> adviceChanges{0};
+
+    static int readPacket(void* opaque, uint8_t* buf, int bufSize);
+    static int64_t seekPacket(void* opaque, int64_t offset, int whence);
+    void advise(bool sequentialAccess);
+
+public:
+    MmapIO() = default;
+    MmapIO(const MmapIO&) = delete;
+    MmapIO& operator=(const MmapIO&) = delete;
+    ~MmapIO();
+
+    // Map the file and create the AVIOContext; false (nothing kept) when the file cannot be mapped
+    bool open(const std::string& path);
+    // Free the AVIOContext and unmap. The AVFormatContext using it must be closed first.
+    void close();
+    bool isOpen() const;
+
+    // Hand this to AVFormatContext::pb (with AVFMT_FLAG_CUSTOM_IO) before avformat_open_input
+    AVIOContext* getContext() const;
+    Stats getStats() const;
+};
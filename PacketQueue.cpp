@@ -0,0 +1,156 @@
+#include "PacketQueue.h"
+
+#include <chrono>
+
+
+PacketQueue::PacketQueue(size_t maxBytes, double maxDuration)
+    : maxBytes(maxBytes), maxDuration(maxDuration) {
+}
+
+PacketQueue::~PacketQueue() {
+    flush();
+}
+
+// Time base of the stream feeding this queue (needed to turn packet durations into seconds)
+void PacketQueue::setTimeBase(AVRational tb) {
+    std::lock_guard<std::mutex> lock(mutex);
+    timeBase = tb;
+}
+
+void PacketQueue::setLimits(size_t bytes, double seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    maxBytes = bytes;
+    maxDuration = seconds;
+}
+
+void PacketQueue::setSpaceCallback(std::function<void()> callback) {
+    onSpace = std::move(callback);
+}
+
+// Append a packet; the caller keeps its (now empty) AVPacket for the next av_read_frame
+bool PacketQueue::put(AVPacket* pkt) {
+    AVPacket* queued = av_packet_alloc();
+    if (!queued) {
+        av_packet_unref(pkt);
+        return false;
+    }
+    av_packet_move_ref(queued, pkt);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (aborted) {
+        av_packet_free(&queued);
+        return false;
+    }
+    byteSize += queued->size + sizeof(AVPacket);
+    durationSum += queued->duration;
+    packets.push_back({queued, serial});
+    cond.notify_one();
+    return true;
+}
+
+bool PacketQueue::tryGet(AVPacket* pkt, int* pktSerial) {
+    bool freedSpace = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (aborted || packets.empty()) return false;
+
+        bool wasFull = fullLocked();
+        Entry entry = packets.front();
+        packets.pop_front();
+        byteSize -= entry.pkt->size + sizeof(AVPacket);
+        durationSum -= entry.pkt->duration;
+        freedSpace = wasFull && !fullLocked();
+
+        av_packet_move_ref(pkt, entry.pkt);
+        av_packet_free(&entry.pkt);
+        if (pktSerial) *pktSerial = entry.serial;
+    }
+    // The producer may be waiting on its own lock for exactly this: never call it with ours held
+    if (freedSpace && onSpace) onSpace();
+    return true;
+}
+
+bool PacketQueue::get(AVPacket* pkt, int* pktSerial, int timeoutMs) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                      [this] { return aborted || !packets.empty(); });
+    }
+    return tryGet(pkt, pktSerial);
+}
+
+// Drop everything (used after a seek) and start a new serial
+int PacketQueue::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Entry& entry : packets) {
+        av_packet_free(&entry.pkt);
+    }
+    packets.clear();
+    byteSize = 0;
+    durationSum = 0;
+    return ++serial;
+}
+
+void PacketQueue::abort() {
+    std::lock_guard<std::mutex> lock(mutex);
+    aborted = true;
+    cond.notify_all();
+}
+
+void PacketQueue::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    aborted = false;
+}
+
+// Buffered duration: packet durations when the container provides them, otherwise the pts span
+double PacketQueue::durationLocked() const {
+    double seconds = durationSum * av_q2d(timeBase);
+    if (packets.size() > 1) {
+        int64_t first = packets.front().pkt->pts;
+        int64_t last = packets.back().pkt->pts;
+        if (first != AV_NOPTS_VALUE && last != AV_NOPTS_VALUE && last > first) {
+            double span = (last - first) * av_q2d(timeBase);
+            if (span > seconds) seconds = span;
+        }
+    }
+    return seconds;
+}
+
+bool PacketQueue::fullLocked() const {
+    return byteSize >= maxBytes || durationLocked() >= maxDuration;
+}
+
+bool PacketQueue::isFull() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return fullLocked();
+}
+
+bool PacketQueue::atByteLimit() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return byteSize >= maxBytes;
+}
+
+bool PacketQueue::isEmpty() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return packets.empty();
+}
+
+size_t PacketQueue::getByteSize() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return byteSize;
+}
+
+double PacketQueue::getDuration() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return durationLocked();
+}
+
+size_t PacketQueue::getCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return packets.size();
+}
+
+int PacketQueue::getSerial() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return serial;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+extern "C"{
+    #include <libavcodec/avcodec.h>
+}
+
+// Thread-safe FIFO of compressed packets shared between the demux thread and a decoder.
+// The queue is bounded both in bytes and in buffered duration; the producer checks isFull()
+// before reading more so a single high-bitrate stream cannot eat all memory, and is woken by
+// the space callback once a consumer takes the queue back below its limits.
+class PacketQueue
+{
+private:
+    struct Entry {
+        AVPacket* pkt;
+        int serial;
+    };
+
+    std::deque<Entry> packets;
+    mutable std::mutex mutex;
+    std::condition_variable cond;
+
+    size_t byteSize = 0;
+    int64_t durationSum = 0;   // sum of packet durations, in stream time_base units
+    AVRational timeBase = {1, AV_TIME_BASE};
+    size_t maxBytes;
+    double maxDuration;
+    int serial = 0;            // bumped on every flush so consumers can detect a discontinuity
+    bool aborted = false;
+    std::function<void()> onSpace;
+
+    double durationLocked() const;
+    bool fullLocked() const;
+
+public:
+    PacketQueue(size_t maxBytes, double maxDuration);
+    ~PacketQueue();
+
+    void setTimeBase(AVRational tb);
+    void setLimits(size_t bytes, double seconds);
+    // Called (outside the queue lock) when a pop takes the queue from full to below its limits.
+    // Set it before any consumer runs.
+    void setSpaceCallback(std::function<void()> callback);
+
+    // Moves the packet reference into the queue (pkt is left blank). Never blocks.
+    bool put(AVPacket* pkt);
+    // Non-blocking pop: returns false immediately when the queue is empty
+    bool tryGet(AVPacket* pkt, int* pktSerial = nullptr);
+    // Blocking pop: waits up to timeoutMs for a packet, returns false on timeout or abort
+    bool get(AVPacket* pkt, int* pktSerial, int timeoutMs);
+
+    int flush();   // drops every queued packet and returns the new serial
+    void abort();  // wakes up any waiting consumer for shutdown
+    void start();  // re-arms the queue after abort()
+
+    bool isFull() const;       // over either limit
+    bool atByteLimit() const;  // over the byte limit: the hard memory cap
+    bool isEmpty() const;
+    size_t getByteSize() const;
+    double getDuration() const;  // buffered duration in seconds
+    size_t getCount() const;
+    int getSerial() const;
+};
@@ -0,0 +1,294 @@
+#include "PrefetchIO.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C"{
+    #include <libavutil/error.h>
+    #include <libavutil/mem.h>
+}
+
+
+PrefetchIO::~PrefetchIO() {
+    close();
+}
+
+bool PrefetchIO::open(const std::string& path, size_t aheadBytes) {
+    close();
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    fileSize = st.st_size;
+    pos = 0;
+    aheadBlocks = std::max<int64_t>(1, static_cast<int64_t>(aheadBytes) / kBlockSize);
+    stopping = false;
+    stats = Stats();
+
+    unsigned char* buffer = static_cast<unsigned char*>(av_malloc(kBufferSize));
+    if (buffer) avio = avio_alloc_context(buffer, kBufferSize, 0, this, &PrefetchIO::readPacket, nullptr, &PrefetchIO::seekPacket);
+    if (!avio) {
+        std::cerr << "Failed to allocate prefetch I/O context\n";
+        av_free(buffer);
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+#ifdef VCPLAYER_HAVE_IO_URING
+    // Room for the whole window plus the stragglers of a window a seek just abandoned
+    unsigned entries = static_cast<unsigned>(std::min<int64_t>(4096, 2 * aheadBlocks + 8));
+    uring = io_uring_queue_init(entries, &ring, 0) == 0;
+    if (uring) {
+        stats.backend = "io_uring";
+        completionThread = std::thread(&PrefetchIO::completionLoop, this);
+        return true;
+    }
+    // Kernel too old or io_uring disabled (containers often block it): use the thread pool
+#endif
+    stats.backend = "pread";
+    for (int i = 0; i < kPreadWorkers; i++) workers.emplace_back(&PrefetchIO::workerLoop, this);
+    return true;
+}
+
+void PrefetchIO::close() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+        for (auto& entry : blocks) entry.second->wanted = false;
+        // Reads still in flight write into block buffers: those must outlive them
+        doneCond.wait(lock, [this] { return inFlight == 0; });
+    }
+    workCond.notify_all();
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+#ifdef VCPLAYER_HAVE_IO_URING
+    if (uring) {
+        // A no-op without a block wakes the completion thread up for the last time
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        if (sqe) {
+            io_uring_prep_nop(sqe);
+            io_uring_sqe_set_data(sqe, nullptr);
+            io_uring_submit(&ring);
+        }
+        if (completionThread.joinable()) completionThread.join();
+        io_uring_queue_exit(&ring);
+        uring = false;
+    }
+#endif
+    blocks.clear();
+    if (avio) {
+        av_freep(&avio->buffer); // avio_context_free leaves the buffer to its owner
+        avio_context_free(&avio);
+    }
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    fileSize = pos = 0;
+}
+
+bool PrefetchIO::isOpen() const {
+    return avio != nullptr;
+}
+
+AVIOContext* PrefetchIO::getContext() const {
+    return avio;
+}
+
+PrefetchIO::Stats PrefetchIO::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+// Keep blocks [index - 1, index + aheadBlocks] requested and forget the rest (the block
+// before is kept because demuxers like to step back a little). Called with the mutex held.
+void PrefetchIO::schedule(int64_t index) {
+    int64_t first = std::max<int64_t>(0, index - 1);
+    int64_t last = std::min(index + aheadBlocks, std::max<int64_t>(0, (fileSize - 1) / kBlockSize));
+    for (auto it = blocks.begin(); it != blocks.end();) {
+        if (it->first < first || it->first > last) {
+            it->second->wanted = false;
+            it = blocks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    // Nearest first, so the block the demuxer needs next never queues behind far read-ahead
+    for (int64_t i = index; i <= last; i++) {
+        if (blocks.count(i)) continue;
+        std::shared_ptr<Block> block = std::make_shared<Block>();
+        block->index = i;
+        blocks[i] = block;
+        submit(block);
+    }
+}
+
+// Start reading a block (mutex held)
+void PrefetchIO::submit(const std::shared_ptr<Block>& block) {
+#ifdef VCPLAYER_HAVE_IO_URING
+    if (uring) {
+        // Submission queue full: park the block, the next completion frees a slot for it
+        // (reading it here would stall the demuxer with the mutex held)
+        if (!queue.empty() || !submitRead(block)) queue.push_back(block);
+        return;
+    }
+#endif
+    queue.push_back(block);
+    workCond.notify_one();
+}
+
+#ifdef VCPLAYER_HAVE_IO_URING
+// Hand a block to the kernel (mutex held); false when the submission queue has no free entry
+bool PrefetchIO::submitRead(const std::shared_ptr<Block>& block) {
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    if (!sqe) return false;
+    block->data.resize(kBlockSize);
+    io_uring_prep_read(sqe, fd, block->data.data(), kBlockSize, block->index * kBlockSize);
+    // The completion owns a reference, so dropping the block from the window is safe
+    io_uring_sqe_set_data(sqe, new std::shared_ptr<Block>(block));
+    io_uring_submit(&ring);
+    inFlight++;
+    return true;
+}
+#endif
+
+// Record the outcome of a read (mutex held) and wake up whoever waits for it
+void PrefetchIO::finish(const std::shared_ptr<Block>& block, long result) {
+    block->size = result > 0 ? static_cast<size_t>(result) : 0;
+    block->failed = result < 0;
+    block->done = true;
+    stats.blocksFetched++;
+    doneCond.notify_all();
+}
+
+// Synchronous read of a whole block (short only at the end of the file); -errno on failure
+long PrefetchIO::readBlock(Block& block) {
+    block.data.resize(kBlockSize);
+    size_t total = 0;
+    off_t offset = block.index * kBlockSize;
+    while (total < static_cast<size_t>(kBlockSize)) {
+        ssize_t got = pread(fd, block.data.data() + total, kBlockSize - total, offset + total);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) return -errno;
+        if (got == 0) break;
+        total += got;
+    }
+    return static_cast<long>(total);
+}
+
+// pread backend: take queued blocks in order, skipping the ones a seek dropped meanwhile
+void PrefetchIO::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        workCond.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (stopping) return;
+        std::shared_ptr<Block> block = queue.front();
+        queue.pop_front();
+        if (!block->wanted) continue;
+        inFlight++;
+        lock.unlock();
+        long result = readBlock(*block);
+        lock.lock();
+        inFlight--;
+        finish(block, result);
+    }
+}
+
+#ifdef VCPLAYER_HAVE_IO_URING
+// io_uring backend: the only consumer of the completion queue
+void PrefetchIO::completionLoop() {
+    while (true) {
+        io_uring_cqe* cqe = nullptr;
+        if (io_uring_wait_cqe(&ring, &cqe) < 0) continue; // interrupted
+        auto* holder = static_cast<std::shared_ptr<Block>*>(io_uring_cqe_get_data(cqe));
+        long result = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+        if (!holder) return; // wake-up from close()
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight--;
+        finish(*holder, result);
+        delete holder;
+        // Blocks parked on a full submission queue, in order (skipping the ones a seek dropped)
+        while (!stopping && !queue.empty()) {
+            if (queue.front()->wanted && !submitRead(queue.front())) break;
+            queue.pop_front();
+        }
+    }
+}
+#endif
+
+int PrefetchIO::readPacket(void* opaque, uint8_t* buf, int bufSize) {
+    PrefetchIO* io = static_cast<PrefetchIO*>(opaque);
+    if (io->pos >= io->fileSize) return AVERROR_EOF;
+    int64_t index = io->pos / kBlockSize;
+
+    std::shared_ptr<Block> block;
+    {
+        std::unique_lock<std::mutex> lock(io->mutex);
+        io->schedule(index);
+        block = io->blocks[index];
+        io->stats.reads++;
+        if (block->done) {
+            io->stats.hits++;
+        } else {
+            // Storage is behind the demuxer: this is the wait the read-ahead is meant to hide
+            auto start = std::chrono::steady_clock::now();
+            io->doneCond.wait(lock, [&block] { return block->done; });
+            io->stats.stalls++;
+            io->stats.stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    // The block is complete and no longer written to: copy without the lock
+    size_t offset = static_cast<size_t>(io->pos - index * kBlockSize);
+    size_t count;
+    if (!block->failed && offset < block->size) {
+        count = std::min(static_cast<size_t>(bufSize), block->size - offset);
+        std::memcpy(buf, block->data.data() + offset, count);
+    } else {
+        // Failed or short read (e.g. the file grew): read directly and report what that gives
+        ssize_t got;
+        do got = pread(io->fd, buf, bufSize, io->pos); while (got < 0 && errno == EINTR);
+        if (got < 0) return AVERROR(errno);
+        if (got == 0) return AVERROR_EOF;
+        count = static_cast<size_t>(got);
+    }
+    io->pos += count;
+    return static_cast<int>(count);
+}
+
+int64_t PrefetchIO::seekPacket(void* opaque, int64_t offset, int whence) {
+    PrefetchIO* io = static_cast<PrefetchIO*>(opaque);
+    whence &= ~AVSEEK_FORCE;
+    if (whence == AVSEEK_SIZE) return io->fileSize;
+
+    int64_t target;
+    if (whence == SEEK_SET) target = offset;
+    else if (whence == SEEK_CUR) target = io->pos + offset;
+    else if (whence == SEEK_END) target = io->fileSize + offset;
+    else return AVERROR(EINVAL);
+    if (target < 0) return AVERROR(EINVAL);
+
+    if (target != io->pos) {
+        std::lock_guard<std::mutex> lock(io->mutex);
+        io->stats.seeks++;
+        int64_t index = target / kBlockSize;
+        // Landed outside the window: move it now, before the demuxer asks for the data
+        if (!io->blocks.count(index)) {
+            io->stats.retargets++;
+            if (target < io->fileSize) io->schedule(index);
+        }
+    }
+    io->pos = target;
+    return target;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef VCPLAYER_HAVE_IO_URING
+#include <liburing.h>
+#endif
+
+extern "C"{
+    #include <libavformat/avio.h>
+}
+
+// AVIOContext that reads the file in 1 MB blocks kept a configurable distance ahead of the
+// demuxer, so slow storage (network mounts, spinning disks) is waited on by the prefetcher
+// instead of by av_read_frame. Blocks are read asynchronously through io_uring when the build
+// has liburing and the kernel allows it, otherwise by a small pool of pread threads. A seek
+// re-targets the window: blocks it no longer covers are dropped (queued reads never start)
+// and the new position is requested first.
+class PrefetchIO
+{
+public:
+    struct Stats {
+        const char* backend = "none";  // io_uring, pread or none
+        uint64_t reads = 0;            // read callbacks served
+        uint64_t hits = 0;             // ...whose block was already there
+        uint64_t stalls = 0;           // ...that had to wait for their block
+        double stallMs = 0.0;          // total time spent waiting
+        uint64_t blocksFetched = 0;
+        uint64_t seeks = 0;
+        uint64_t retargets = 0;        // seeks that landed outside the prefetched window
+    };
+
+private:
+    static constexpr int kBufferSize = 64 * 1024;           // AVIO refill size
+    static constexpr int64_t kBlockSize = 1024 * 1024;      // prefetch granularity
+    static constexpr int kPreadWorkers = 2;
+
+    struct Block {
+        int64_t index = 0;
+        std::vector<uint8_t> data;
+        size_t size = 0;         // bytes actually read
+        bool done = false;
+        bool failed = false;
+        bool wanted = true;      // still inside the window (queued reads of dropped blocks are skipped)
+    };
+
+    int fd = -1;
+    int64_t fileSize = 0;
+    int64_t pos = 0;             // demuxer position (demux thread only)
+    int64_t aheadBlocks = 0;
+    AVIOContext* avio = nullptr;
+
+    std::mutex mutex;
+    std::condition_variable doneCond;   // a block finished (reader and close() wait on it)
+    std::condition_variable workCond;   // pread backend: a block was queued
+    std::map<int64_t, std::shared_ptr<Block>> blocks;  // the current window
+    std::deque<std::shared_ptr<Block>> queue;          // not started yet (io_uring: no free submission entry)
+    std::vector<std::thread> workers;
+    int inFlight = 0;            // reads the kernel or a worker is still writing into
+    bool stopping = false;
+    Stats stats;
+
+#ifdef VCPLAYER_HAVE_IO_URING
+    struct io_uring ring;
+    bool uring = false;
+    std::thread completionThread;
+    bool submitRead(const std::shared_ptr<Block>& block);
+    void completionLoop();
+#endif
+
+    static int readPacket(void* opaque, uint8_t* buf, int bufSize);
+    static int64_t seekPacket(void* opaque, int64_t offset, int whence);
+    void schedule(int64_t index);
+    void submit(const std::shared_ptr<Block>& block);
+    void finish(const std::shared_ptr<Block>& block, long result);
+    long readBlock(Block& block);
+    void workerLoop();
+
+public:
+    PrefetchIO() = default;
+    PrefetchIO(const PrefetchIO&) = delete;
+    PrefetchIO& operator=(const PrefetchIO&) = delete;
+    ~PrefetchIO();
+
+    // Open the file and start the backend; aheadBytes is how far the window reaches past the
+    // demuxer. False (nothing kept) when the file cannot be opened.
+    bool open(const std::string& path, size_t aheadBytes);
+    // Wait for outstanding reads and free everything. The AVFormatContext must be closed first.
+    void close();
+    bool isOpen() const;
+
+    // Hand this to AVFormatContext::pb (with AVFMT_FLAG_CUSTOM_IO) before avformat_open_input
+    AVIOContext* getContext() const;
+    Stats getStats();
+};
@@ -0,0 +1,291 @@
+#include "ReverseDecoder.h"
+
+#include <algorithm>
+#include <iostream>
+
+
+// Pictures this close are the same picture (timestamps go through double conversions)
+static const double kPtsEpsilon = 1e-4;
+
+static size_t pictureBytes(const AVFrame* frame) {
+    size_t bytes = 0;
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; i++) {
+        bytes += frame->buf[i]->size;
+    }
+    return bytes;
+}
+
+ReverseDecoder::~ReverseDecoder() {
+    close();
+}
+
+bool ReverseDecoder::start(const std::string& path, int index, double from, const InputOptions& input,
+                           const DecoderThreadingOptions& threading, int lowres, const KeyframeIndex* keyframes, size_t budget) {
+    stop();
+    // Reversing again in the same file: the worker seeks the open context, nothing is re-probed
+    if (!fmtCtx || path != openPath || index != streamIndex || lowres != openLowres) {
+        close();
+        if (!open(path, index, input, threading, lowres)) {
+            close();
+            return false;
+        }
+    }
+    keyframeIndex = keyframes;
+    budgetBytes = budget;
+    startPosition = from;
+    abortRequest = false;
+    exhausted = false;
+    redecodes = 0;
+    worker = std::thread(&ReverseDecoder::workerLoop, this);
+    return true;
+}
+
+// Private demuxer and decoder, opened through the same I/O and probing as the player's
+bool ReverseDecoder::open(const std::string& path, int index, const InputOptions& input,
+                          const DecoderThreadingOptions& threading, int lowres) {
+    const char* streamInfo = nullptr;
+    if (!openInput(path, input, &mmapIO, &prefetchIO, streamInfoCache, &fmtCtx, &streamInfo)) {
+        std::cerr << "Reverse: failed to open input file\n";
+        return false;
+    }
+    if (index >= (int)fmtCtx->nb_streams) {
+        std::cerr << "Reverse: video stream not found\n";
+        return false;
+    }
+    // Only the video stream is needed
+    for (unsigned i = 0; i < fmtCtx->nb_streams; i++) {
+        if ((int)i != index) fmtCtx->streams[i]->discard = AVDISCARD_ALL;
+    }
+    AVCodecParameters* par = fmtCtx->streams[index]->codecpar;
+    const AVCodec* codec = avcodec_find_decoder(par->codec_id);
+    if (!codec) {
+        std::cerr << "Reverse: decoder not found\n";
+        return false;
+    }
+    codecCtx = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(codecCtx, par);
+    codecCtx->lowres = lowres;
+    applyDecoderThreading(codecCtx, codec, threading);
+    if (avcodec_open2(codecCtx, codec, nullptr) < 0) {
+        std::cerr << "Reverse: failed to open video decoder\n";
+        return false;
+    }
+    streamIndex = index;
+    timeBase = fmtCtx->streams[index]->time_base;
+    openPath = path;
+    openLowres = lowres;
+    return true;
+}
+
+void ReverseDecoder::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        abortRequest = true;
+    }
+    cond.notify_all();
+    if (worker.joinable()) worker.join();
+    for (Picture& picture : ready) freePicture(picture);
+    ready.clear();
+    readyBytes = 0;
+}
+
+void ReverseDecoder::close() {
+    stop();
+    if (codecCtx) avcodec_free_context(&codecCtx);
+    if (fmtCtx) avformat_close_input(&fmtCtx);
+    // The readers back fmtCtx's I/O: only closed once it is gone
+    mmapIO.close();
+    prefetchIO.close();
+    openPath.clear();
+    streamIndex = -1;
+}
+
+void ReverseDecoder::freePicture(Picture& picture) {
+    av_frame_free(&picture.frame);
+}
+
+// Worker: one segment per iteration, walking from startPosition towards the start of the file
+void ReverseDecoder::workerLoop() {
+    double upper = startPosition;   // pictures at or after this were already handed out
+    double searchFrom = upper;      // the next keyframe has to be before this
+    std::vector<Picture> segment;
+    while (!abortRequest) {
+        double keyTime = 0.0;
+        int64_t keyTimestamp = 0;
+        if (!findKeyframeBefore(searchFrom, &keyTime, &keyTimestamp)) break;
+
+        double lowest = upper;
+        if (!decodeSegment(keyTimestamp, keyTime, upper, segment, &lowest)) break;
+        if (segment.empty()) {
+            // Nothing decodable between the keyframe and upper (a broken GOP, or the keyframe
+            // turned out to be the picture at upper itself): decode from the one before it,
+            // still up to upper so none of the pictures in between are lost
+            searchFrom = keyTime;
+            continue;
+        }
+        // Older pictures of this GOP were dropped for the budget: decode it again for them
+        if (lowest > keyTime + kPtsEpsilon) redecodes++;
+        if (!handOver(segment)) break;
+        upper = searchFrom = lowest;
+    }
+    for (Picture& picture : segment) freePicture(picture);
+    exhausted = true;
+}
+
+// Keyframe whose pts is strictly before pos, from the index when it knows, else by asking the demuxer
+bool ReverseDecoder::findKeyframeBefore(double pos, double* keyTime, int64_t* keyTimestamp) {
+    KeyframeIndex::Keyframe kf;
+    if (keyframeIndex && keyframeIndex->find(pos - kPtsEpsilon, &kf) && kf.time < pos - kPtsEpsilon) {
+        *keyTime = kf.time;
+        *keyTimestamp = kf.timestamp;
+        return true;
+    }
+    // Unindexed: seek backwards from a little before pos and see where the demuxer lands,
+    // going further back until it is a keyframe before pos
+    AVPacket* pkt = av_packet_alloc();
+    bool found = false;
+    for (double back = 0.001; !found && !abortRequest && pos - back > -1.0; back *= 4.0) {
+        int64_t target = static_cast<int64_t>(std::max(0.0, pos - back) / av_q2d(timeBase));
+        if (av_seek_frame(fmtCtx, streamIndex, target, AVSEEK_FLAG_BACKWARD) < 0) break;
+        while (av_read_frame(fmtCtx, pkt) >= 0) {
+            bool isKey = pkt->stream_index == streamIndex && (pkt->flags & AV_PKT_FLAG_KEY);
+            int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            av_packet_unref(pkt);
+            if (!isKey || ts == AV_NOPTS_VALUE) continue;
+            if (ts * av_q2d(timeBase) < pos - kPtsEpsilon) {
+                *keyTime = ts * av_q2d(timeBase);
+                *keyTimestamp = ts;
+                found = true;
+            }
+            break;
+        }
+        if (pos - back < 0.0) break; // already tried from the very start
+    }
+    av_packet_free(&pkt);
+    return found;
+}
+
+// Decode from the keyframe up to upper, keeping the newest pictures that fit half the budget
+bool ReverseDecoder::decodeSegment(int64_t keyTimestamp, double keyTime, double upper,
+                                   std::vector<Picture>& kept, double* lowest) {
+    kept.clear();
+    size_t keptBytes = 0;
+    size_t segmentBudget = budgetBytes / 2;
+    size_t firstKept = 0;   // kept[firstKept..] are still in, earlier ones were pushed out
+
+    if (av_seek_frame(fmtCtx, streamIndex, keyTimestamp, AVSEEK_FLAG_BACKWARD) < 0) return false;
+    avcodec_flush_buffers(codecCtx);
+
+    AVPacket* pkt = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    bool reachedUpper = false;
+    bool draining = false;
+    while (!abortRequest && !reachedUpper) {
+        if (!draining) {
+            int ret = av_read_frame(fmtCtx, pkt);
+            if (ret < 0) {
+                avcodec_send_packet(codecCtx, nullptr);  // end of file: flush what is left
+                draining = true;
+            } else {
+                if (pkt->stream_index == streamIndex) avcodec_send_packet(codecCtx, pkt);
+                av_packet_unref(pkt);
+            }
+        }
+        int ret;
+        while ((ret = avcodec_receive_frame(codecCtx, frame)) == 0) {
+            int64_t ts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+            double pts = ts * av_q2d(timeBase);
+            if (pts >= upper - kPtsEpsilon) {
+                reachedUpper = true;
+                av_frame_unref(frame);
+                break;
+            }
+            if (pts < keyTime - kPtsEpsilon) { av_frame_unref(frame); continue; } // leading pictures of an open GOP
+            Picture picture;
+            picture.frame = av_frame_alloc();
+            av_frame_move_ref(picture.frame, frame);
+            picture.pts = pts;
+            picture.duration = picture.frame->duration > 0 ? picture.frame->duration * av_q2d(timeBase) : 0.0;
+            keptBytes += pictureBytes(picture.frame);
+            kept.push_back(picture);
+            // Over budget: the oldest pictures go; a later pass decodes the GOP again for them
+            while (keptBytes > segmentBudget && kept.size() - firstKept > 1) {
+                keptBytes -= pictureBytes(kept[firstKept].frame);
+                freePicture(kept[firstKept]);
+                firstKept++;
+            }
+        }
+        if (draining) break; // the flush above already gave back everything
+    }
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+
+    kept.erase(kept.begin(), kept.begin() + firstKept);
+    if (abortRequest) {
+        for (Picture& picture : kept) freePicture(picture);
+        kept.clear();
+        return false;
+    }
+    if (!kept.empty()) *lowest = kept.front().pts;
+    return true;
+}
+
+// Queue a decoded segment (ascending pts) for the render thread once there is room for it
+bool ReverseDecoder::handOver(std::vector<Picture>& segment) {
+    size_t bytes = 0;
+    for (const Picture& picture : segment) bytes += pictureBytes(picture.frame);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    // At most one segment waits while the next one is decoded
+    cond.wait(lock, [&] { return abortRequest || readyBytes == 0 || readyBytes + bytes <= budgetBytes / 2; });
+    if (abortRequest) {
+        for (Picture& picture : segment) freePicture(picture);
+        segment.clear();
+        return false;
+    }
+    for (auto it = segment.rbegin(); it != segment.rend(); ++it) {
+        ready.push_back(*it);
+    }
+    readyBytes += bytes;
+    segment.clear();
+    return true;
+}
+
+bool ReverseDecoder::peek(Picture* out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ready.empty()) return false;
+    *out = ready.front();
+    return true;
+}
+
+bool ReverseDecoder::peekNext(Picture* out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ready.size() < 2) return false;
+    *out = ready[1];
+    return true;
+}
+
+void ReverseDecoder::pop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (ready.empty()) return;
+        readyBytes -= pictureBytes(ready.front().frame);
+        freePicture(ready.front());
+        ready.pop_front();
+    }
+    cond.notify_all();
+}
+
+bool ReverseDecoder::finished() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return exhausted && ready.empty();
+}
+
+size_t ReverseDecoder::getByteSize() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return readyBytes;
+}
+
+int ReverseDecoder::getRedecodes() const {
+    return redecodes;
+}
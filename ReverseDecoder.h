@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DecoderConfig.h"
+#include "InputOpener.h"
+#include "KeyframeIndex.h"
+
+extern "C"{
+    #include <libavformat/avformat.h>
+    #include <libavcodec/avcodec.h>
+}
+
+// Reverse playback source. A worker thread with its own demuxer and decoder walks the file
+// backwards one GOP at a time: it seeks to the keyframe before the current position, decodes
+// forward up to that position and hands the pictures over newest first. While the render
+// thread plays one segment, the worker is already decoding the one before it. All positions
+// are presentation times. The demuxer and decoder stay open across start()/stop() for the
+// same file, a restart only seeks them.
+//
+// Memory is bounded by the byte budget: half of it for pictures waiting to be shown, half for
+// the segment being decoded. A GOP that does not fit is split, keeping the newest pictures
+// and re-decoding the GOP from its keyframe for the older part.
+class ReverseDecoder
+{
+public:
+    struct Picture {
+        AVFrame* frame = nullptr;   // native decoder format
+        double pts = 0.0;
+        double duration = 0.0;
+    };
+
+private:
+    AVFormatContext* fmtCtx = nullptr;
+    AVCodecContext* codecCtx = nullptr;
+    MmapIO mmapIO;             // the private context reads like the player's (see openInput)
+    PrefetchIO prefetchIO;
+    StreamInfoCache streamInfoCache;
+    std::string openPath;      // what fmtCtx/codecCtx were opened for
+    int openLowres = 0;
+    int streamIndex = -1;
+    AVRational timeBase = {1, 1};
+    const KeyframeIndex* keyframeIndex = nullptr;
+    size_t budgetBytes = 0;
+    double startPosition = 0.0;
+
+    std::deque<Picture> ready;      // descending pts; front is the next one to show
+    size_t readyBytes = 0;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread worker;
+    std::atomic<bool> abortRequest{false};
+    std::atomic<bool> exhausted{false};   // worker reached the start of the stream
+    std::atomic<int> redecodes{0};        // extra passes over GOPs that did not fit
+
+    bool open(const std::string& path, int index, const InputOptions& input,
+              const DecoderThreadingOptions& threading, int lowres);
+    void workerLoop();
+    bool findKeyframeBefore(double pos, double* keyTime, int64_t* keyTimestamp);
+    bool decodeSegment(int64_t keyTimestamp, double keyTime, double upper, std::vector<Picture>& kept, double* lowest);
+    bool handOver(std::vector<Picture>& segment);
+    static void freePicture(Picture& picture);
+
+public:
+    ~ReverseDecoder();
+
+    // Start producing pictures before position `from`, opening path on a private context
+    // unless it is already open. lowres: reduced-resolution decode level, the same as the
+    // forward decoder's
+    bool start(const std::string& path, int streamIndex, double from, const InputOptions& input,
+               const DecoderThreadingOptions& threading, int lowres, const KeyframeIndex* index, size_t budget);
+    void stop();    // stops the worker and drops its pictures, the contexts stay open
+    void close();   // stop() and free the contexts (another file is loaded)
+
+    // Render thread: next picture in reverse order (false while none is decoded yet)
+    bool peek(Picture* out);
+    bool peekNext(Picture* out);   // the one after peek(), to skip late pictures
+    void pop();
+    bool finished();   // the first picture of the stream has been handed out
+
+    size_t getByteSize();
+    int getRedecodes() const;
+};
@@ -0,0 +1,294 @@
+#include "StreamInfoCache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+#include <vector>
+#include <sys/stat.h>
+
+extern "C"{
+    #include <libavutil/channel_layout.h>
+    #include <libavutil/mem.h>
+}
+
+
+namespace {
+
+constexpr const char* kMagic = "vcplayer-streaminfo 2";
+
+// Everything find_stream_info may fill in for one stream
+struct CachedStream {
+    int codecType = 0, codecId = 0;
+    uint32_t codecTag = 0;
+    int format = -1;
+    int64_t bitRate = 0;
+    int profile = 0, level = 0, width = 0, height = 0;
+    int sarNum = 0, sarDen = 1;
+    int fieldOrder = 0, colorRange = 0, colorPrimaries = 0, colorTrc = 0, colorSpace = 0, chromaLocation = 0;
+    int videoDelay = 0;
+    int chOrder = 0, channels = 0;
+    uint64_t chMask = 0;
+    int sampleRate = 0, blockAlign = 0, frameSize = 0, initialPadding = 0;
+    int bitsPerCodedSample = 0, bitsPerRawSample = 0;
+    int tbNum = 0, tbDen = 1, avgNum = 0, avgDen = 1, rNum = 0, rDen = 1;
+    int64_t startTime = 0, duration = 0, nbFrames = 0;
+    int disposition = 0;
+    std::vector<uint8_t> extradata;
+};
+
+// One field list for both directions, so the writer and the reader cannot disagree on order
+template <typename F>
+void visitFields(CachedStream& s, F&& f) {
+    f(s.codecType); f(s.codecId); f(s.codecTag); f(s.format); f(s.bitRate);
+    f(s.profile); f(s.level); f(s.width); f(s.height); f(s.sarNum); f(s.sarDen);
+    f(s.fieldOrder); f(s.colorRange); f(s.colorPrimaries); f(s.colorTrc); f(s.colorSpace); f(s.chromaLocation);
+    f(s.videoDelay); f(s.chOrder); f(s.channels); f(s.chMask);
+    f(s.sampleRate); f(s.blockAlign); f(s.frameSize); f(s.initialPadding);
+    f(s.bitsPerCodedSample); f(s.bitsPerRawSample);
+    f(s.tbNum); f(s.tbDen); f(s.avgNum); f(s.avgDen); f(s.rNum); f(s.rDen);
+    f(s.startTime); f(s.duration); f(s.nbFrames); f(s.disposition);
+}
+
+CachedStream capture(const AVStream* st) {
+    const AVCodecParameters* par = st->codecpar;
+    CachedStream s;
+    s.codecType = par->codec_type;
+    s.codecId = par->codec_id;
+    s.codecTag = par->codec_tag;
+    s.format = par->format;
+    s.bitRate = par->bit_rate;
+    s.profile = par->profile;
+    s.level = par->level;
+    s.width = par->width;
+    s.height = par->height;
+    s.sarNum = par->sample_aspect_ratio.num;
+    s.sarDen = par->sample_aspect_ratio.den;
+    s.fieldOrder = par->field_order;
+    s.colorRange = par->color_range;
+    s.colorPrimaries = par->color_primaries;
+    s.colorTrc = par->color_trc;
+    s.colorSpace = par->color_space;
+    s.chromaLocation = par->chroma_location;
+    s.videoDelay = par->video_delay;
+    s.chOrder = par->ch_layout.order;
+    s.channels = par->ch_layout.nb_channels;
+    s.chMask = par->ch_layout.order == AV_CHANNEL_ORDER_NATIVE ? par->ch_layout.u.mask : 0;
+    s.sampleRate = par->sample_rate;
+    s.blockAlign = par->block_align;
+    s.frameSize = par->frame_size;
+    s.initialPadding = par->initial_padding;
+    s.bitsPerCodedSample = par->bits_per_coded_sample;
+    s.bitsPerRawSample = par->bits_per_raw_sample;
+    s.tbNum = st->time_base.num;
+    s.tbDen = st->time_base.den;
+    s.avgNum = st->avg_frame_rate.num;
+    s.avgDen = st->avg_frame_rate.den;
+    s.rNum = st->r_frame_rate.num;
+    s.rDen = st->r_frame_rate.den;
+    s.startTime = st->start_time;
+    s.duration = st->duration;
+    s.nbFrames = st->nb_frames;
+    s.disposition = st->disposition;
+    if (par->extradata && par->extradata_size > 0) s.extradata.assign(par->extradata, par->extradata + par->extradata_size);
+    return s;
+}
+
+bool restore(const CachedStream& s, AVStream* st) {
+    AVCodecParameters* par = st->codecpar;
+    // The demuxer already read the header: only fill in extradata it did not find itself
+    if (!s.extradata.empty() && par->extradata_size == 0) {
+        uint8_t* data = static_cast<uint8_t*>(av_mallocz(s.extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+        if (!data) return false;
+        std::copy(s.extradata.begin(), s.extradata.end(), data);
+        av_freep(&par->extradata);
+        par->extradata = data;
+        par->extradata_size = static_cast<int>(s.extradata.size());
+    }
+    par->codec_id = (AVCodecID)s.codecId;
+    par->codec_tag = s.codecTag;
+    par->format = s.format;
+    par->bit_rate = s.bitRate;
+    par->profile = s.profile;
+    par->level = s.level;
+    par->width = s.width;
+    par->height = s.height;
+    par->sample_aspect_ratio = AVRational{s.sarNum, s.sarDen};
+    par->field_order = (AVFieldOrder)s.fieldOrder;
+    par->color_range = (AVColorRange)s.colorRange;
+    par->color_primaries = (AVColorPrimaries)s.colorPrimaries;
+    par->color_trc = (AVColorTransferCharacteristic)s.colorTrc;
+    par->color_space = (AVColorSpace)s.colorSpace;
+    par->chroma_location = (AVChromaLocation)s.chromaLocation;
+    par->video_delay = s.videoDelay;
+    if (s.channels > 0) {
+        av_channel_layout_uninit(&par->ch_layout);
+        if (s.chOrder == AV_CHANNEL_ORDER_NATIVE) av_channel_layout_from_mask(&par->ch_layout, s.chMask);
+        else av_channel_layout_default(&par->ch_layout, s.channels);
+    }
+    par->sample_rate = s.sampleRate;
+    par->block_align = s.blockAlign;
+    par->frame_size = s.frameSize;
+    par->initial_padding = s.initialPadding;
+    par->bits_per_coded_sample = s.bitsPerCodedSample;
+    par->bits_per_raw_sample = s.bitsPerRawSample;
+    st->time_base = AVRational{s.tbNum, s.tbDen};
+    st->avg_frame_rate = AVRational{s.avgNum, s.avgDen};
+    st->r_frame_rate = AVRational{s.rNum, s.rDen};
+    st->start_time = s.startTime;
+    st->duration = s.duration;
+    st->nb_frames = s.nbFrames;
+    st->disposition = s.disposition;
+    return true;
+}
+
+std::string toHex(const std::vector<uint8_t>& bytes) {
+    if (bytes.empty()) return "-";
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(bytes.size() * 2);
+    for (uint8_t b : bytes) {
+        hex += digits[b >> 4];
+        hex += digits[b & 15];
+    }
+    return hex;
+}
+
+bool fromHex(const std::string& hex, std::vector<uint8_t>* bytes) {
+    bytes->clear();
+    if (hex == "-") return true;
+    if (hex.size() % 2) return false;
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        char pair[3] = {hex[i], hex[i + 1], 0};
+        char* end = nullptr;
+        long value = std::strtol(pair, &end, 16);
+        if (*end) return false;
+        bytes->push_back(static_cast<uint8_t>(value));
+    }
+    return true;
+}
+
+// FNV-1a: stable across builds, unlike std::hash
+uint64_t hashPath(const std::string& path) {
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char c : path) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+} // namespace
+
+
+StreamInfoCache::StreamInfoCache() {
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+    if (xdg && *xdg) directory = std::string(xdg) + "/vcplayer/streaminfo";
+    else if (home && *home) directory = std::string(home) + "/.cache/vcplayer/streaminfo";
+}
+
+void StreamInfoCache::setDirectory(const std::string& dir) {
+    directory = dir;
+}
+
+std::string StreamInfoCache::entryFile(const std::string& mediaPath) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.txt", (unsigned long long)hashPath(mediaPath));
+    return directory + "/" + name;
+}
+
+// Size and modification time (ns) identify the version of the file the entry describes
+bool StreamInfoCache::fileKey(const std::string& path, int64_t* size, int64_t* mtime) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    *size = st.st_size;
+    *mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    return true;
+}
+
+bool StreamInfoCache::apply(AVFormatContext* fmtCtx, const std::string& path, bool fastProbe) const {
+    int64_t size = 0, mtime = 0;
+    if (directory.empty() || !fileKey(path, &size, &mtime)) return false;
+    std::ifstream in(entryFile(path));
+    if (!in) return false;
+
+    // Parse and check everything before touching fmtCtx
+    std::string line, word;
+    if (!std::getline(in, line) || line != kMagic) return false;
+    if (!std::getline(in, line) || line != "path " + path) return false; // hash collision
+    int64_t cachedSize = -1, cachedMtime = -1;
+    if (!std::getline(in, line)) return false;
+    std::istringstream fileLine(line);
+    if (!(fileLine >> word >> cachedSize >> cachedMtime) || word != "file" ||
+        cachedSize != size || cachedMtime != mtime) return false;   // the file changed since
+    // A full probe's parameters serve any open, a fast probe's only another fast open
+    if (!std::getline(in, line)) return false;
+    if (line != "probe full" && !(fastProbe && line == "probe fast")) return false;
+
+    int64_t duration = 0, startTime = 0, bitRate = 0;
+    unsigned streamCount = 0;
+    if (!std::getline(in, line)) return false;
+    std::istringstream formatLine(line);
+    if (!(formatLine >> word >> duration >> startTime >> bitRate >> streamCount) || word != "format") return false;
+    // Streams the demuxer only discovers while reading packets cannot be restored up front
+    if (streamCount != fmtCtx->nb_streams || streamCount == 0) return false;
+
+    std::vector<CachedStream> streams(streamCount);
+    for (unsigned i = 0; i < streamCount; i++) {
+        if (!std::getline(in, line)) return false;
+        std::istringstream streamLine(line);
+        bool ok = static_cast<bool>(streamLine >> word) && word == "stream";
+        visitFields(streams[i], [&](auto& field) { if (ok && !(streamLine >> field)) ok = false; });
+        std::string hex;
+        if (!ok || !(streamLine >> hex) || !fromHex(hex, &streams[i].extradata)) return false;
+        // Same layout as when it was probed (the header parse already knows types and codecs)
+        const AVCodecParameters* par = fmtCtx->streams[i]->codecpar;
+        if (par->codec_type != streams[i].codecType) return false;
+        if (par->codec_id != AV_CODEC_ID_NONE && par->codec_id != streams[i].codecId) return false;
+    }
+
+    for (unsigned i = 0; i < streamCount; i++) {
+        if (!restore(streams[i], fmtCtx->streams[i])) return false;
+    }
+    fmtCtx->duration = duration;
+    fmtCtx->start_time = startTime;
+    fmtCtx->bit_rate = bitRate;
+    return true;
+}
+
+bool StreamInfoCache::store(const AVFormatContext* fmtCtx, const std::string& path, bool fastProbe) const {
+    int64_t size = 0, mtime = 0;
+    if (directory.empty() || !fileKey(path, &size, &mtime)) return false;
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        std::cerr << "Cannot create stream info cache " << directory << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    std::string target = entryFile(path);
+    std::string temp = target + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::trunc);
+        if (!out) return false;
+        out << kMagic << "\n";
+        out << "path " << path << "\n";
+        out << "file " << size << " " << mtime << "\n";
+        out << "probe " << (fastProbe ? "fast" : "full") << "\n";
+        out << "format " << fmtCtx->duration << " " << fmtCtx->start_time << " " << fmtCtx->bit_rate
+            << " " << fmtCtx->nb_streams << "\n";
+        for (unsigned i = 0; i < fmtCtx->nb_streams; i++) {
+            CachedStream s = capture(fmtCtx->streams[i]);
+            out << "stream";
+            visitFields(s, [&out](auto& field) { out << " " << field; });
+            out << " " << toHex(s.extradata) << "\n";
+        }
+        if (!out) return false;
+    }
+    // Readers only ever see a complete entry
+    return std::rename(temp.c_str(), target.c_str()) == 0;
+}
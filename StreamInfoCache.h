@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+extern "C"{
+    #include <libavformat/avformat.h>
+}
+
+// On-disk cache of what avformat_find_stream_info() learned about a file (codec parameters,
+// frame rates, durations), keyed by path, size and modification time. Re-opening a known file
+// restores the streams from here and skips probing, which can take seconds on large or oddly
+// muxed files. One small text file per media file under the cache directory. Each entry also
+// records how thoroughly the file was probed: a bounded (fast-open) probe may have missed
+// parameters that a full probe would find, so it only ever serves other fast opens.
+class StreamInfoCache
+{
+private:
+    std::string directory;
+
+    std::string entryFile(const std::string& mediaPath) const;
+    static bool fileKey(const std::string& path, int64_t* size, int64_t* mtime);
+
+public:
+    StreamInfoCache();   // $XDG_CACHE_HOME/vcplayer/streaminfo (or ~/.cache/...)
+    void setDirectory(const std::string& dir);
+
+    // Fill the streams of a context just returned by avformat_open_input from the cache.
+    // fastProbe: the caller would have probed with bounded limits, so an entry from a fast
+    // probe is good enough; otherwise only a full probe's entry is used.
+    // True when the entry matched and probing can be skipped; false leaves fmtCtx untouched.
+    bool apply(AVFormatContext* fmtCtx, const std::string& path, bool fastProbe) const;
+    // Remember the probed parameters of path and how they were probed (replaces an older entry)
+    bool store(const AVFormatContext* fmtCtx, const std::string& path, bool fastProbe) const;
+};
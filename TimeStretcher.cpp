@@ -0,0 +1,184 @@
+#include "TimeStretcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+void TimeStretcher::configure(int frequency, int channelCount, bool s16Samples) {
+    channels = channelCount;
+    sampleRate = frequency > 0 ? frequency : 1;
+    s16 = s16Samples;
+    // 30 ms segments: long enough for low voices, short enough not to smear transients
+    segment = std::max<size_t>(64, static_cast<size_t>(sampleRate * 0.030) & ~static_cast<size_t>(1));
+    hop = segment / 2;
+    search = std::min(hop, static_cast<size_t>(sampleRate * 0.012));
+    // Periodic Hann: two windows half a segment apart add up to exactly 1
+    window.resize(segment);
+    for (size_t i = 0; i < segment; i++) {
+        window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * M_PI * i / segment));
+    }
+    reset();
+}
+
+void TimeStretcher::setRate(double newRate) {
+    rate = newRate;
+}
+
+double TimeStretcher::getRate() const {
+    return rate;
+}
+
+bool TimeStretcher::isActive() const {
+    return rate != 1.0 && channels > 0;
+}
+
+void TimeStretcher::reset() {
+    input.clear();
+    tail.assign(hop * channels, 0.0f);
+    analysisPos = 0.0;
+    lastPos = 0;
+    started = false;
+}
+
+double TimeStretcher::getBufferedSeconds() const {
+    if (channels <= 0) return 0.0;
+    double frames = static_cast<double>(input.size() / channels);
+    if (!started) return frames / sampleRate;
+    // Stretching goes on from the ideal start of the next segment, a play-out from the input
+    // the overlap tail continues into
+    double next = isActive() ? analysisPos : static_cast<double>(lastPos + hop);
+    return std::max(0.0, frames - next) / sampleRate;
+}
+
+void TimeStretcher::appendInput(const uint8_t* data, size_t size) {
+    size_t base = input.size();
+    if (s16) {
+        size_t count = size / sizeof(int16_t);
+        input.resize(base + count);
+        const int16_t* samples = reinterpret_cast<const int16_t*>(data);
+        for (size_t i = 0; i < count; i++) input[base + i] = samples[i] * (1.0f / 32768.0f);
+    } else {
+        size_t count = size / sizeof(float);
+        input.resize(base + count);
+        std::memcpy(&input[base], data, count * sizeof(float));
+    }
+}
+
+// Start of the segment in [from, to] whose first half looks most like `natural` (the input
+// that followed the previous segment), by normalised cross-correlation of the channel sums
+size_t TimeStretcher::bestOffset(size_t from, size_t to, size_t natural) const {
+    auto score = [this, natural](size_t pos, size_t stride) {
+        double corr = 0.0, energy = 1e-9;
+        for (size_t i = 0; i < hop; i += stride) {
+            const float* a = &input[(pos + i) * channels];
+            const float* b = &input[(natural + i) * channels];
+            float monoA = 0.0f, monoB = 0.0f;
+            for (int c = 0; c < channels; c++) {
+                monoA += a[c];
+                monoB += b[c];
+            }
+            corr += monoA * monoB;
+            energy += monoA * monoA;
+        }
+        return corr / std::sqrt(energy);
+    };
+
+    // Coarse pass over every other candidate with every 4th frame, then refine around the winner
+    size_t best = from;
+    double bestScore = -INFINITY;
+    for (size_t pos = from; pos <= to; pos += 2) {
+        double s = score(pos, 4);
+        if (s > bestScore) { bestScore = s; best = pos; }
+    }
+    size_t coarse = best;
+    bestScore = -INFINITY;
+    for (size_t pos = coarse > from ? coarse - 1 : from; pos <= std::min(coarse + 1, to); pos++) {
+        double s = score(pos, 1);
+        if (s > bestScore) { bestScore = s; best = pos; }
+    }
+    return best;
+}
+
+size_t TimeStretcher::process(const uint8_t* in, size_t size, const uint8_t** out) {
+    if (!isActive()) {
+        if (channels > 0 && (started || !input.empty())) return flush(in, size, out);
+        *out = in;
+        return size;
+    }
+    appendInput(in, size);
+    output.clear();
+
+    size_t frames = input.size() / channels;
+    while (true) {
+        size_t ideal = static_cast<size_t>(analysisPos);
+        size_t from = started ? (ideal > search ? ideal - search : 0) : 0;
+        size_t to = started ? ideal + search : 0;
+        if (to + segment > frames) break;   // wait for more input
+        size_t pos = started ? bestOffset(from, to, lastPos + hop) : 0;
+
+        // The first half of this segment completes the tail of the previous one
+        const float* seg = &input[pos * channels];
+        size_t base = output.size();
+        output.resize(base + hop * channels);
+        for (size_t i = 0; i < hop; i++) {
+            float fadeIn = window[i];
+            float fadeOut = window[hop + i];
+            for (int c = 0; c < channels; c++) {
+                size_t k = i * channels + c;
+                // The very first segment starts at full level: it continues unstretched sound
+                output[base + k] = started ? tail[k] + fadeIn * seg[k] : seg[k];
+                tail[k] = fadeOut * seg[hop * channels + k];
+            }
+        }
+        lastPos = pos;
+        started = true;
+        analysisPos += hop * rate;
+    }
+
+    // Drop input that no later segment (or its similarity reference) can reach
+    size_t reachable = analysisPos > search ? static_cast<size_t>(analysisPos) - search : 0;
+    size_t drop = std::min(lastPos, reachable);
+    if (drop > 0) {
+        input.erase(input.begin(), input.begin() + drop * channels);
+        lastPos -= drop;
+        analysisPos -= drop;
+    }
+
+    return emitOutput(out);
+}
+
+// Back at 1x: play out the input the stretcher still holds, crossfading the overlap tail into
+// the input it continues into, followed by the new chunk as it is
+size_t TimeStretcher::flush(const uint8_t* in, size_t size, const uint8_t** out) {
+    appendInput(in, size);
+    size_t frames = input.size() / channels;
+    size_t from = started ? std::min(lastPos + hop, frames) : 0;
+    output.assign(input.begin() + from * channels, input.end());
+    if (started) {
+        size_t overlap = std::min(hop, frames - from);
+        for (size_t i = 0; i < overlap; i++) {
+            for (int c = 0; c < channels; c++) {
+                size_t k = i * channels + c;
+                output[k] = tail[k] + window[i] * output[k];
+            }
+        }
+    }
+    reset();
+    return emitOutput(out);
+}
+
+size_t TimeStretcher::emitOutput(const uint8_t** out) {
+    if (!s16) {
+        *out = reinterpret_cast<const uint8_t*>(output.data());
+        return output.size() * sizeof(float);
+    }
+    outBytes.resize(output.size() * sizeof(int16_t));
+    int16_t* samples = reinterpret_cast<int16_t*>(outBytes.data());
+    for (size_t i = 0; i < output.size(); i++) {
+        long v = std::lrintf(output[i] * 32768.0f);
+        samples[i] = static_cast<int16_t>(std::clamp(v, -32768L, 32767L));
+    }
+    *out = outBytes.data();
+    return outBytes.size();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Pitch-preserving tempo change for interleaved PCM in the device format (WSOLA: waveform
+// similarity overlap-add). Output is built from Hann-windowed segments laid down every `hop`
+// frames; each segment is taken from around where the rate says the input should be, shifted
+// within a small search window to the spot that best continues the waveform already played,
+// so periodic sound does not get phase jumps. Audio decode thread only.
+class TimeStretcher
+{
+private:
+    int channels = 0;
+    int sampleRate = 0;
+    bool s16 = false;              // device format: true for S16, false for float
+    double rate = 1.0;             // media seconds consumed per second of output
+    size_t segment = 0;            // segment length in frames (two hops)
+    size_t hop = 0;                // output advance per segment, in frames
+    size_t search = 0;             // how far a segment may move from its ideal position (frames)
+    std::vector<float> window;     // Hann window over one segment
+    std::vector<float> input;      // buffered input, interleaved
+    std::vector<float> tail;       // windowed second half of the last segment, still to be overlapped
+    std::vector<float> output;     // stretched samples produced by the last process()
+    std::vector<uint8_t> outBytes; // output converted back to S16
+    double analysisPos = 0.0;      // ideal start of the next segment in input (frames)
+    size_t lastPos = 0;            // where the last segment was actually taken from
+    bool started = false;          // at least one segment has been laid down since reset()
+
+    size_t bestOffset(size_t from, size_t to, size_t natural) const;
+    void appendInput(const uint8_t* data, size_t size);
+    size_t flush(const uint8_t* in, size_t size, const uint8_t** out);
+    size_t emitOutput(const uint8_t** out);
+
+public:
+    // Set up for the device format; keeps the current rate and drops buffered audio
+    void configure(int frequency, int channelCount, bool s16Samples);
+    // Takes effect from the next segment: buffered input and the overlap tail are kept, so the
+    // sound carries on without a gap or a click (back to 1x, the next process() plays them out)
+    void setRate(double newRate);
+    double getRate() const;
+    bool isActive() const;   // false at 1x, where process() hands the input straight back
+    void reset();
+    // Media time between the next output sample and the end of the input given so far: the
+    // next output plays what was fed this long before the end of the last chunk
+    double getBufferedSeconds() const;
+
+    // Stretch a chunk of PCM. *out points at the result (valid until the next call); its size
+    // is returned and may be 0 while the stretcher is still collecting a full segment.
+    size_t process(const uint8_t* in, size_t size, const uint8_t** out);
+};
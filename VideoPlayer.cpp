@@ -1,21 +1,20 @@
 #include "VideoPlayer.h"
+#include "AudioGain.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 
+VideoPlayer::~VideoPlayer() {
+    cleanup();
+}
 
 // Load and initialize resources for the selected media file (video and audio)
 bool VideoPlayer::load(const std::string& filepath, SDL_Renderer* renderer) {
     cleanup(); // Always clean any previous video, decoder, and texture state before loading new file
+    loadStartedAt = Clock::now();
 
-    // Open the media file (all formats, let ffmpeg auto-detect container)
-    if (avformat_open_input(&fmtCtx, filepath.c_str(), nullptr, nullptr) != 0) {
-        std::cerr << "Failed to open input file\n";
-        return false;
-    }
-    // Scan for all stream info (finds audio, video, subtitle, etc.)
-    if (avformat_find_stream_info(fmtCtx, nullptr) < 0) {
-        std::cerr << "Failed to find stream info\n";
-        return false;
-    }
+    if (!openStream(filepath)) return false;
 
     // ==================== AUDIO SETUP ====================
     // Find and open audio stream/codec if present (optional: may not exist)
@@ -41,21 +40,38 @@ bool VideoPlayer::load(const std::string& filepath, SDL_Renderer* renderer) {
         // ----- Get audio channel count (modern FFmpeg: ch_layout.nb_channels), fallback to 2 if not present
         channels2 = AudioCodecCtx->ch_layout.nb_channels > 0 ? AudioCodecCtx->ch_layout.nb_channels : 2;
 
-        // Prepare SDL for audio output matching the decoded audio (try to match ideal: stereo/float, else S16)
+        // Prepare SDL for audio output close to the decoded audio (s16 sources stay s16, everything
+        // else plays as float); rate and channel count may be changed by SDL to what the device likes
+        bool s16Source = AudioCodecCtx->sample_fmt == AV_SAMPLE_FMT_S16 || AudioCodecCtx->sample_fmt == AV_SAMPLE_FMT_S16P;
         SDL_AudioSpec wanted, obtained; // desired and actually got
         wanted.freq = AudioCodecCtx->sample_rate;
         wanted.channels = channels2;
-        wanted.format = (AudioCodecCtx->sample_fmt == AV_SAMPLE_FMT_FLT) ? AUDIO_F32SYS : AUDIO_S16SYS;
+        wanted.format = s16Source ? AUDIO_S16SYS : AUDIO_F32SYS;
         wanted.silence = 0;
         wanted.samples = 2048; // buffer length (2048 sample-frames)
-        wanted.callback = nullptr; // use SDL_QueueAudio
+        wanted.callback = &VideoPlayer::audioCallback; // SDL pulls from our ring buffer
+        wanted.userdata = this;
 
         // Open the SDL audio device
-        audioDevice = SDL_OpenAudioDevice(nullptr, 0, &wanted, &obtained, 0);
+        audioDevice = SDL_OpenAudioDevice(nullptr, 0, &wanted, &obtained,
+                                          SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_CHANNELS_CHANGE);
         if (!audioDevice) {
             std::cerr << "SDL could not open audio device: " << SDL_GetError() << std::endl;
             avcodec_free_context(&AudioCodecCtx); AudioCodecCtx = nullptr;
         } else {
+            audioSpec = obtained;
+            audioBytesPerSec = obtained.freq * obtained.channels * (SDL_AUDIO_BITSIZE(obtained.format) / 8);
+            // Everything the decoder produces gets resampled to exactly this (swrCtx is built lazily)
+            deviceSampleFmt = obtained.format == AUDIO_S16SYS ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_FLT;
+            av_channel_layout_uninit(&deviceLayout);
+            av_channel_layout_default(&deviceLayout, obtained.channels);
+            deviceBytesPerFrame = obtained.channels * av_get_bytes_per_sample(deviceSampleFmt);
+            // The ring must exist before the callback first runs
+            audioRing.reset(static_cast<size_t>(kAudioRingSeconds * audioBytesPerSec));
+            appliedGain = volume; // start at the current volume, no ramp on the first buffer
+            ringAnchors.clear();
+            stretcher.configure(obtained.freq, obtained.channels, deviceSampleFmt == AV_SAMPLE_FMT_S16);
+            ringSerial = -1;
             SDL_PauseAudioDevice(audioDevice, 0); // Start playback immediately
         }
         audioFrame = av_frame_alloc(); // Creates empty audio frame to receive decoded PCM
@@ -77,177 +93,1176 @@ bool VideoPlayer::load(const std::string& filepath, SDL_Renderer* renderer) {
 
     AVCodecParameters* codecPar = fmtCtx->streams[videoStreamIndex]->codecpar;
     const AVCodec* codec = avcodec_find_decoder(codecPar->codec_id);
+    if (!codec) {
+        std::cerr << "Decoder not found\n";
+        return false;
+    }
     CodecCtx = avcodec_alloc_context3(codec);
     avcodec_parameters_to_context(CodecCtx, codecPar);
-    avcodec_open2(CodecCtx, codec, nullptr);
 
-    width = CodecCtx->width;
-    height = CodecCtx->height;
+    // Shape of the letterboxed display rectangle (anamorphic streams have non-square pixels)
+    AVRational sar = av_guess_sample_aspect_ratio(fmtCtx, fmtCtx->streams[videoStreamIndex], nullptr);
+    displayAspect = CodecCtx->height > 0 ? static_cast<double>(CodecCtx->width) / CodecCtx->height : 1.0;
+    if (sar.num > 0 && sar.den > 0) displayAspect *= av_q2d(sar);
+    updateDisplayRect(renderer);
+
+    // Lowres and threading must be configured before the decoder is opened
+    CodecCtx->lowres = chooseLowres(codec);
+    applyDecoderThreading(CodecCtx, codec, options.videoThreading);
+    if (avcodec_open2(CodecCtx, codec, nullptr) < 0) {
+        std::cerr << "Failed to open video decoder\n";
+        return false;
+    }
 
-    // Set up pixel format conversion context (planar YUV → packed RGB) for SDL
-    swsCtx = sws_getContext(
-        width, height, CodecCtx->pix_fmt,                  // input: width, height, pixfmt from codec
-        width, height, AV_PIX_FMT_RGB24,                   // output: width, height, pixel format RGB24
-        SWS_BILINEAR, nullptr, nullptr, nullptr
-    );
+    width = CodecCtx->width;   // already reduced when decoding at lowres
+    height = CodecCtx->height;
 
-    frame = av_frame_alloc();     // Allocates space for raw video frame (decoded)
-    rgbFrame = av_frame_alloc();  // Will hold RGB24 data for SDL
-    packet = av_packet_alloc();   // Large-enough space for compressed packet
+    // Nominal frame duration, used when a picture carries no duration of its own
+    AVRational frameRate = fmtCtx->streams[videoStreamIndex]->avg_frame_rate;
+    frameDuration = (frameRate.num > 0 && frameRate.den > 0) ? av_q2d(av_inv_q(frameRate)) : 1.0 / 25.0;
 
-    // Allocate buffer for RGB frame, and associate with frame's data pointers/strides
-    int numBytes = av_image_get_buffer_size(AV_PIX_FMT_RGB24, width, height, 1);
-    uint8_t* buffer = (uint8_t*)av_malloc(numBytes); // raw buffer for converted RGB data
-    av_image_fill_arrays(rgbFrame->data, rgbFrame->linesize, buffer,
-                         AV_PIX_FMT_RGB24, width, height, 1);
+    // Pick the upload path: yuv420p and nv12 go straight into a matching streaming texture,
+    // everything else is converted to RGB24 by swscale (context created lazily on first use)
+    videoRenderer = renderer;
+    directIYUV = directNV12 = false;
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) == 0) {
+        for (Uint32 i = 0; i < info.num_texture_formats; i++) {
+            if (info.texture_formats[i] == SDL_PIXELFORMAT_IYUV) directIYUV = true;
+            if (info.texture_formats[i] == SDL_PIXELFORMAT_NV12) directNV12 = true;
+        }
+    }
+    // Let SDL choose BT.601/BT.709 from the picture height, like FFmpeg does
+    SDL_SetYUVConversionMode(SDL_YUV_CONVERSION_AUTOMATIC);
 
     // Actually create the SDL texture: the GPU-visible surface we update each frame
-    texture = SDL_CreateTexture(
-        renderer, SDL_PIXELFORMAT_RGB24,
-        SDL_TEXTUREACCESS_STREAMING, width, height
-    );
+    AVPixelFormat expected = CodecCtx->pix_fmt;
+    bool direct = (expected == AV_PIX_FMT_YUV420P && directIYUV) || (expected == AV_PIX_FMT_NV12 && directNV12);
+    ensureTexture(direct ? expected : AV_PIX_FMT_RGB24, width, height);
 
     // Reset state for playback loop
     frameReady = false;
     isPaused = false;
     currentPts = 0.0;
     seekTargetTime = -1.0f;
+    masterClock.setPaused(false);
+    resetClock();
+
+    stats = PlaybackStats();
+    stats.videoCodec = codec->name;
+    stats.decoderThreads = CodecCtx->thread_count;
+    stats.decoderThreadType = describeThreadType(CodecCtx->active_thread_type);
+    stats.streamInfo = streamInfoSource;
+    stats.openMs = openMs;
+    lateFramesDropped = 0;
+    skipLevelChanges = 0;
+    seekKeyframeGap = 0.0;
+    seekCatchupFrames = 0;
+    seekCatchupMs = 0.0;
+    seeksCoalesced = 0;
+    seeksAbandoned = 0;
+    cacheHits = 0;
+    framesFromCache = 0;
+    // Pictures of the previous file are useless now
+    frameCache.clear();
+    frameCache.setBudget(options.frameCacheBytes);
+    // Large pictures are converted in parallel bands (the decode thread is not running yet)
+    scaler.setThreads(options.scaleThreads);
+    renderScaler.setThreads(options.scaleThreads);
+
+    // Keyframe positions for seeking (may keep scanning in the background)
+    keyframeIndex.build(fmtCtx, videoStreamIndex, filepath, options.input);
+    loadedPath = filepath; // reverse playback opens its own demuxer on it
+    skipWindowFrames = skipWindowLate = skipWindowHeadroom = 0;
+    consecutiveLateDrops = 0;
+    // Start every file with a full-quality decode
+    skipLevel = 0;
+    rateSkipsNonRef = false; // the new decoder starts out decoding everything
+    cacheAwaitsKeyframe = false;
+
+    // From here on only the demux thread touches fmtCtx for reading, only the video decode
+    // thread touches CodecCtx/scaler, only the audio decode thread touches AudioCodecCtx,
+    // and the render thread owns texture
+    startDemuxer();
+    startVideoDecoder();
+    startAudioDecoder();
 
     return true;
 }
 
-// Decodes the next available video frame (and any queued audio packets) to ready for display
-void VideoPlayer::decodeNextFrame() {
-    frameReady = false;
-    while (true) {
-        if (av_read_frame(fmtCtx, packet) < 0) {
-            // End of stream or read error
-            return;
+// Start the read-ahead thread for the freshly opened file
+void VideoPlayer::startDemuxer() {
+    videoQueue.setLimits(options.videoQueueBytes, options.queueSeconds);
+    audioQueue.setLimits(options.audioQueueBytes, options.queueSeconds);
+    videoQueue.setTimeBase(fmtCtx->streams[videoStreamIndex]->time_base);
+    if (audioStreamIndex != -1) audioQueue.setTimeBase(fmtCtx->streams[audioStreamIndex]->time_base);
+    // The decoders wake the demuxer when they make room, it does not poll
+    videoQueue.setSpaceCallback([this] { wakeDemuxer(); });
+    audioQueue.setSpaceCallback([this] { wakeDemuxer(); });
+    videoQueue.start();
+    audioQueue.start();
+    videoSerial = videoQueue.flush();
+    audioQueue.flush();
+    audioSerial = -1; // first audio packet takes the flush path and stamps the ring's serial
+    seekRequested = false;
+    seekInFlight = false;
+    seekSerial = -1;
+    seekSerialTarget = -1.0;
+    servicedSeekGeneration = seekGeneration.load();
+    demuxAbort = false;
+    demuxEof = false;
+    demuxThread = std::thread(&VideoPlayer::demuxLoop, this);
+}
+
+// Stop and join the demux thread (safe to call when it is not running)
+void VideoPlayer::stopDemuxer() {
+    {
+        std::lock_guard<std::mutex> lock(demuxMutex);
+        demuxAbort = true;
+    }
+    demuxCond.notify_all();
+    videoQueue.abort();
+    audioQueue.abort();
+    if (demuxThread.joinable()) demuxThread.join();
+    videoQueue.flush();
+    audioQueue.flush();
+}
+
+// A consumer took a queue below its limits. Taking demuxMutex orders this against the demuxer's
+// check, so the wake-up cannot slip in between its check and its wait.
+void VideoPlayer::wakeDemuxer() {
+    std::lock_guard<std::mutex> lock(demuxMutex);
+    demuxCond.notify_all();
+}
+
+// Demux thread: services seek requests and reads packets ahead into the per-stream queues.
+// Like ffplay it sleeps when any queue reaches its byte cap (bounded memory whatever the
+// interleaving) or when every stream has enough queued; a stream that is absent or has stopped
+// delivering packets counts as having enough. It is woken by seeks and by the decoders.
+void VideoPlayer::demuxLoop() {
+    AVPacket* pkt = av_packet_alloc();
+    bool keyframeRead = false;   // the current position is a scrub preview
+    bool holdReadAhead = false;  // ...and its keyframe is queued: nothing more to read
+    // Time of the last packet read per stream: a stream that fell more than a queue's worth
+    // behind the other one has ended (or is too sparse to ever fill its queue)
+    double lastVideoTime = -1.0;
+    double lastAudioTime = -1.0;
+    while (!demuxAbort) {
+        bool doSeek = false;
+        double seekTime = 0.0;
+        bool keyframeOnly = false;
+        int generation = 0;
+        {
+            std::unique_lock<std::mutex> lock(demuxMutex);
+            // Read-ahead is satisfied (or the file is exhausted): wait for the decoders to drain
+            bool hasAudio = audioStreamIndex != -1 && AudioCodecCtx;
+            bool atCap = videoQueue.atByteLimit() || (hasAudio && audioQueue.atByteLimit());
+            bool videoEnough = videoQueue.isFull() ||
+                               (lastVideoTime >= 0.0 && lastAudioTime - lastVideoTime > options.queueSeconds);
+            bool audioEnough = !hasAudio || audioQueue.isFull() ||
+                               (lastAudioTime >= 0.0 && lastVideoTime - lastAudioTime > options.queueSeconds);
+            if (!seekRequested && (demuxEof || holdReadAhead || atCap || (videoEnough && audioEnough))) {
+                demuxCond.wait(lock);
+                continue;
+            }
+            if (seekRequested) {
+                doSeek = true;
+                seekTime = requestedSeekTime;
+                keyframeOnly = requestedKeyframeOnly;
+                generation = seekGeneration;
+                seekRequested = false;
+                seekInFlight = true;
+            }
         }
-        // --- Video packet? decode and push to screen ---
-        if (packet->stream_index == videoStreamIndex) {
-            avcodec_send_packet(CodecCtx, packet);
-            if (avcodec_receive_frame(CodecCtx, frame) == 0) {
-                float pts = frame->pts * av_q2d(fmtCtx->streams[videoStreamIndex]->time_base); // pts → seconds
-                currentPts = pts;
-                // If user recently sought: skip frames until we're at/playhead
-                if (seekTargetTime >= 0.0f) {
-                    if (pts < seekTargetTime) { av_packet_unref(packet); continue; }
-                    else seekTargetTime = -1.0f; // Arrived at or past seek point
-                }
-                // Convert YUV to RGB24 and update GPU video texture
-                sws_scale(
-                    swsCtx, frame->data, frame->linesize, 0, height,
-                    rgbFrame->data, rgbFrame->linesize
+
+        if (doSeek) {
+            if (!seekToKeyframe(seekTime)) {
+                // Not indexed (yet): let the demuxer find a keyframe before the target itself
+                AVStream* stream = fmtCtx->streams[videoStreamIndex];
+                int64_t targetTimestamp = av_rescale_q(
+                    static_cast<int64_t>(seekTime * AV_TIME_BASE),
+                    AV_TIME_BASE_Q, stream->time_base
                 );
-                SDL_UpdateTexture(texture, nullptr, rgbFrame->data[0], rgbFrame->linesize[0]);
-                frameReady = true; // ready for renderFrame()
-                av_packet_unref(packet);
-                return;
+                if (av_seek_frame(fmtCtx, videoStreamIndex, targetTimestamp, AVSEEK_FLAG_BACKWARD) < 0) {
+                    std::cerr << "Seek failed\n";
+                }
+                seekKeyframeGap = -1.0;
             }
+            // Drop stale read-ahead; decoders notice the new serial and flush themselves
+            int serial = videoQueue.flush();
+            audioQueue.flush();
+            {
+                std::lock_guard<std::mutex> lock(demuxMutex);
+                seekSerial = serial;
+                seekSerialTarget = seekTime;
+                seekSerialKeyframeOnly = keyframeOnly;
+                seekInFlight = false;
+            }
+            servicedSeekGeneration = generation;
+            demuxEof = false;
+            keyframeRead = keyframeOnly;
+            holdReadAhead = false;
+            lastVideoTime = lastAudioTime = -1.0;
+            continue;
         }
-        // --- Audio packet? Decode and play sound (if device available) ---
-        if (AudioCodecCtx && audioDevice && packet->stream_index == audioStreamIndex) {
-            avcodec_send_packet(AudioCodecCtx, packet);
-            while (avcodec_receive_frame(AudioCodecCtx, audioFrame) == 0) {
-                // Compute required raw buffer size for the decoded PCM
-                int data_size = av_samples_get_buffer_size(
-                    nullptr,
-                    channels2, // Use our detected channel count
-                    audioFrame->nb_samples,
-                    AudioCodecCtx->sample_fmt,
-                    1
-                );
-                // Only direct-play for planar float or s16 (most common for mp4, avi, mkv)
-                if (AudioCodecCtx->sample_fmt == AV_SAMPLE_FMT_FLT) {
-                    float* samples = (float*)audioFrame->data[0]; //it is just a pointer to the first channel
-                    int num_samples = audioFrame->nb_samples * channels2; // total samples in all channels
-                    // Scale volume if needed
-                    for(int i = 0; i < num_samples; i++){
-                        samples[i] *= volume;
-                    }
-                         
-                    SDL_QueueAudio(audioDevice,audioFrame->data[0], data_size);
-                } 
-                else if (AudioCodecCtx->sample_fmt == AV_SAMPLE_FMT_S16) {
-                    int16_t* samples = (int16_t*)audioFrame->data[0]; // pointer to first channel
-                    int num_samples = audioFrame->nb_samples * channels2; // total samples in all channels
-                    
-                    for (short i = 0; i < num_samples; i++)
-                    {
-                        //since it is 16 bit , we need to consider the overflow
-                        int32_t v = samples[i] * volume;
-                        if(v > INT16_MAX) v = INT16_MAX;
-                        else if(v < INT16_MIN) v = INT16_MIN;
-                        samples[i] = static_cast<int16_t>(v); // scale volume
-                    }
-                    
-                    SDL_QueueAudio(audioDevice, audioFrame->data[0], data_size);
-                } 
-                
-                
-                
-                else {
-                    // Audio is skipped if sample_fmt is not directly compatible (rare in popular files)
+
+        int ret = av_read_frame(fmtCtx, pkt);
+        if (ret < 0) {
+            // End of file (or a read error we cannot recover from): idle until the next seek
+            demuxEof = true;
+            continue;
+        }
+        int64_t ts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+        if (pkt->stream_index == videoStreamIndex) {
+            bool key = pkt->flags & AV_PKT_FLAG_KEY;
+            if (key) keyframeIndex.notePacket(pkt);
+            if (ts != AV_NOPTS_VALUE) lastVideoTime = ts * av_q2d(fmtCtx->streams[videoStreamIndex]->time_base);
+            videoQueue.put(pkt);
+            // A scrub preview needs exactly one keyframe; stop until the next request
+            if (keyframeRead && key) holdReadAhead = true;
+        } else if (AudioCodecCtx && pkt->stream_index == audioStreamIndex) {
+            if (ts != AV_NOPTS_VALUE) lastAudioTime = ts * av_q2d(fmtCtx->streams[audioStreamIndex]->time_base);
+            audioQueue.put(pkt);
+        } else {
+            av_packet_unref(pkt);
+        }
+    }
+    av_packet_free(&pkt);
+}
+
+// Open the container and get its stream parameters into fmtCtx
+bool VideoPlayer::openStream(const std::string& filepath) {
+    double openStart = Clock::now();
+    if (!openInput(filepath, options.input, &mmapIO, &prefetchIO, streamInfoCache, &fmtCtx, &streamInfoSource)) {
+        return false;
+    }
+    openMs = (Clock::now() - openStart) * 1000.0;
+    return true;
+}
+
+// Position the demuxer on the indexed keyframe at or before seekTime. Scanned indexes jump to
+// the packet's byte offset (the containers that need a scan have no cheaper way to get there),
+// container indexes seek to the keyframe's exact timestamp so the demuxer's lookup is a hit.
+bool VideoPlayer::seekToKeyframe(double seekTime) {
+    KeyframeIndex::Keyframe kf;
+    if (!keyframeIndex.find(seekTime, &kf)) return false;
+
+    bool byteSeek = keyframeIndex.getSource() == KeyframeIndex::Source::Scan && kf.pos >= 0 &&
+                    !(fmtCtx->iformat->flags & AVFMT_NO_BYTE_SEEK);
+    int ret = byteSeek ? av_seek_frame(fmtCtx, videoStreamIndex, kf.pos, AVSEEK_FLAG_BYTE)
+                       : av_seek_frame(fmtCtx, videoStreamIndex, kf.timestamp, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) return false;
+    seekKeyframeGap = seekTime - kf.time;
+    return true;
+}
+
+// Hand a seek over to the demux thread; a newer request replaces one that has not started yet
+void VideoPlayer::requestSeek(double time, bool keyframeOnly) {
+    {
+        std::lock_guard<std::mutex> lock(demuxMutex);
+        if (seekRequested) seeksCoalesced++; // the older target was never started
+        seekRequested = true;
+        seekGeneration++;
+        requestedSeekTime = time;
+        requestedKeyframeOnly = keyframeOnly;
+    }
+    demuxCond.notify_all();
+}
+
+// True from a seek request until the demuxer has flushed the queues for it
+bool VideoPlayer::seekPending() {
+    std::lock_guard<std::mutex> lock(demuxMutex);
+    return seekRequested || seekInFlight;
+}
+
+// A seek newer than the one the queues currently hold is waiting to be flushed (lock-free,
+// checked by the decoders for every packet)
+bool VideoPlayer::newerSeekPending() const {
+    return seekGeneration != servicedSeekGeneration;
+}
+
+// Seek target that applies to packets of the given serial (-1 when that serial is not a seek)
+double VideoPlayer::seekTargetForSerial(int serial, bool* keyframeOnly) {
+    std::lock_guard<std::mutex> lock(demuxMutex);
+    if (keyframeOnly) *keyframeOnly = serial == seekSerial && seekSerialKeyframeOnly;
+    return serial == seekSerial ? seekSerialTarget : -1.0;
+}
+
+// Start the worker that turns video packets into presentable pictures
+void VideoPlayer::startVideoDecoder() {
+    frameQueue.start();
+    frameQueue.clear();
+    videoDecodeAbort = false;
+    videoDecodeThread = std::thread(&VideoPlayer::videoDecodeLoop, this);
+}
+
+void VideoPlayer::stopVideoDecoder() {
+    videoDecodeAbort = true;
+    frameQueue.abort();   // unblocks a decoder waiting for a free slot
+    if (videoDecodeThread.joinable()) videoDecodeThread.join();
+    frameQueue.clear();
+}
+
+// Video decode thread: pulls packets from the demuxer, decodes, converts to RGB24 and
+// queues the pictures with their PTS. The render thread only picks a picture and uploads it.
+// Every decoded picture is also kept in frameCache; a seek that lands inside a cached span is
+// replayed from there while the decoder quietly resumes behind the end of that span.
+void VideoPlayer::videoDecodeLoop() {
+    AVPacket* pkt = av_packet_alloc();
+    AVFrame* decoded = av_frame_alloc();
+    AVFrame* cached = av_frame_alloc();
+    AVRational timeBase = fmtCtx->streams[videoStreamIndex]->time_base;
+    int serial = 0;
+    bool scrubPreview = false;  // current serial is a keyframe-only scrub seek
+    bool scrubShown = false;    // ...whose keyframe has already been queued
+    bool cacheContinues = false; // the next decoded picture directly follows the last one cached
+    bool replaying = false;      // serving the current seek from frameCache
+    double replayStart = 0.0;    // first cached picture of the replay
+    double replayEnd = 0.0;      // last picture of the cached span when the replay started
+    double replayPts = -1.0;     // last picture handed over from the cache (<0: none yet)
+    double resumeKeyTime = -1.0; // replay: video packets before this keyframe are not needed
+    double dropUntilPts = -1.0;  // decoded pictures up to here were already shown from the cache
+    double lastDecodedPts = -1.0;
+
+    while (!videoDecodeAbort) {
+        if (replaying) {
+            // Hand cached pictures over whenever the queue has room, decode in between
+            if (frameQueue.size() < frameQueue.capacity() && !newerSeekPending()) {
+                double pts = 0.0, duration = 0.0;
+                bool got = replayPts < 0.0 ? frameCache.fetch(replayStart, cached, &duration)
+                                           : frameCache.fetchNext(replayPts, cached, &pts, &duration);
+                if (got) {
+                    if (replayPts < 0.0) pts = replayStart;
+                    replayPts = pts;
+                    framesFromCache++;
+                    // Stale: a seek flushed the queue under us, the serial change ends this replay
+                    if (queuePicture(cached, pts, duration, serial) == QueueResult::Stale) replaying = false;
+                    continue;
                 }
+                // End of the cached span: the decoder takes over behind the last replayed picture
+                replaying = false;
+                dropUntilPts = replayPts;
+            }
+            // Do not let the decoder run far past the cached span while the replay catches up
+            if (replaying && lastDecodedPts > std::max(replayPts, replayEnd) + kReplayDecodeAhead) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                continue;
+            }
+        }
+        // Short timeout so shutdown is noticed even when the demuxer is idle
+        if (!videoQueue.get(pkt, &serial, replaying ? 2 : 10)) continue;
+
+        // New serial means the demuxer seeked: drop decoder state and aim for the seek target
+        if (serial != videoSerial) {
+            avcodec_flush_buffers(CodecCtx);
+            videoSerial = serial;
+            double target = seekTargetForSerial(serial, &scrubPreview);
+            seekTargetTime = static_cast<float>(target);
+            // Scrub previews show the keyframe itself, no catch-up to the exact target
+            if (scrubPreview) seekTargetTime = -1.0f;
+            scrubShown = false;
+            skipWindowFrames = skipWindowLate = skipWindowHeadroom = 0;
+            catchupStart = Clock::now();
+            catchupFrames = 0;
+            cacheContinues = false;
+            replaying = false;
+            dropUntilPts = -1.0;
+            lastDecodedPts = -1.0;
+            resumeKeyTime = -1.0;
+            // Landed in something we decoded recently: replay it, no catch-up needed
+            if (!scrubPreview && target >= 0.0 && frameCache.findRun(target, &replayStart, &replayEnd) &&
+                replayEnd - replayStart >= kMinCachedRun) {
+                replaying = true;
+                replayPts = -1.0;
+                seekTargetTime = -1.0f;
+                cacheHits++;
+                // The decoder only has to rebuild its state from the keyframe before the span's end
+                KeyframeIndex::Keyframe kf;
+                if (keyframeIndex.find(replayEnd, &kf) && kf.time > target) resumeKeyTime = kf.time;
+            }
+        }
+        if (scrubPreview && scrubShown) { av_packet_unref(pkt); continue; }
+        // The user already moved on: do not decode towards a target nobody will see
+        if (newerSeekPending()) {
+            if (seekTargetTime >= 0.0f) {
+                seeksAbandoned++;
+                seekTargetTime = -1.0f;
+            }
+            cacheContinues = false;
+            av_packet_unref(pkt);
+            continue;
+        }
+        // Fast playback cannot show more than kMaxShownFps pictures a second anyway:
+        // leave the non-reference ones undecoded instead of dropping them after the work is done
+        bool rateSkip = playbackRate / frameDuration > kMaxShownFps;
+        if (rateSkip != rateSkipsNonRef) {
+            rateSkipsNonRef = rateSkip;
+            applySkipLevel(skipLevel);
+        }
+        bool key = pkt->flags & AV_PKT_FLAG_KEY;
+        if (resumeKeyTime >= 0.0) {
+            // Everything before this keyframe is being replayed from the cache
+            int64_t pktTs = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            if (!key || pktTs == AV_NOPTS_VALUE || pktTs * av_q2d(timeBase) < resumeKeyTime - 0.001) {
+                av_packet_unref(pkt);
+                continue;
+            }
+            resumeKeyTime = -1.0;
+        }
+        avcodec_send_packet(CodecCtx, pkt);
+        av_packet_unref(pkt); // Always unref the packet after processing (FFmpeg requirement)
+        // Drain right away: frame threads would otherwise hold the keyframe back for more input
+        // (the next serial change flushes the decoder out of its drained state)
+        if (scrubPreview && key) avcodec_send_packet(CodecCtx, nullptr);
+
+        while (!videoDecodeAbort && avcodec_receive_frame(CodecCtx, decoded) == 0) {
+            int64_t ts = decoded->best_effort_timestamp != AV_NOPTS_VALUE ? decoded->best_effort_timestamp : decoded->pts;
+            double pts = ts * av_q2d(timeBase); // pts → seconds
+            double duration = decoded->duration > 0 ? decoded->duration * av_q2d(timeBase) : 0.0;
+            if (newerSeekPending()) { cacheContinues = false; av_frame_unref(decoded); continue; }
+            lastDecodedPts = pts;
+
+            // Remember it for later rewinds (not while pictures are skipped: the span would have holes,
+            // nor after it until a keyframe has cleared the degraded references)
+#ifdef AV_FRAME_FLAG_KEY
+            bool keyPicture = decoded->flags & AV_FRAME_FLAG_KEY;
+#else
+            bool keyPicture = decoded->key_frame;
+#endif
+            bool skipping = skipLevel > 0 || rateSkipsNonRef;
+            if (keyPicture && !skipping) cacheAwaitsKeyframe = false;
+            if (!scrubPreview && !skipping && !cacheAwaitsKeyframe) {
+                frameCache.insert(decoded, pts, duration, cacheContinues);
+                cacheContinues = true;
+            } else {
+                cacheContinues = false;
+            }
+            // During a replay new pictures reach the screen through the cache
+            if (replaying) { av_frame_unref(decoded); continue; }
+            if (dropUntilPts >= 0.0) {
+                if (pts <= dropUntilPts) { av_frame_unref(decoded); continue; }
+                dropUntilPts = -1.0;
+            }
+            // If user recently sought: skip frames until we're at/playhead. The picture on screen
+            // at the target is the one whose display slot covers it, not the first one after it
+            // (a step back seeks half a picture before the current one to land on its predecessor)
+            if (seekTargetTime >= 0.0f) {
+                double shownUntil = pts + (duration > 0.0 ? duration : frameDuration);
+                if (shownUntil <= seekTargetTime + kSeekSlotSlack) {
+                    catchupFrames++;
+                    av_frame_unref(decoded);
+                    continue;
+                }
+                // Arrived at or past seek point
+                seekTargetTime = -1.0f;
+                seekCatchupFrames = catchupFrames;
+                seekCatchupMs = (Clock::now() - catchupStart) * 1000.0;
+            }
+
+            QueueResult result = queuePicture(decoded, pts, duration, serial);
+            if (result == QueueResult::Stale) break;
+            if (result == QueueResult::Queued && scrubPreview) scrubShown = true;
+        }
+    }
+    av_frame_free(&cached);
+    av_frame_free(&decoded);
+    av_packet_free(&pkt);
+}
+
+// Put a picture into the next frame queue slot, converting it when the texture cannot take it
+// as-is. The picture is consumed (unreferenced) whatever happens.
+VideoPlayer::QueueResult VideoPlayer::queuePicture(AVFrame* picture, double pts, double duration, int serial) {
+    // Waits here while the queue is full, i.e. while the render thread is ahead of us
+    FrameQueue::Frame* slot = frameQueue.peekWritable();
+    // Aborted, or a seek arrived while we waited: this picture is already stale
+    if (!slot || serial != videoQueue.getSerial()) {
+        av_frame_unref(picture);
+        return QueueResult::Stale;
+    }
+    // Already behind the clock: drop it before paying for the conversion
+    bool late = isFrameLate(pts);
+    updateSkipPolicy(pts, late);
+    if (late && consecutiveLateDrops < kMaxConsecutiveDrops) {
+        consecutiveLateDrops++;
+        lateFramesDropped++;
+        av_frame_unref(picture);
+        return QueueResult::Dropped;
+    }
+    consecutiveLateDrops = 0;
+    bool queued = true;
+    int scaledWidth, scaledHeight;
+    if (canUploadDirectly(picture) && !scaledSize(picture, &scaledWidth, &scaledHeight)) {
+        // Zero-conversion path: the slot just takes a reference to the decoder's picture
+        av_frame_unref(slot->frame);
+        av_frame_move_ref(slot->frame, picture);
+    } else {
+        queued = convertFrame(picture, slot->frame, &scaler);
+    }
+    av_frame_unref(picture);
+    if (!queued) return QueueResult::Dropped;
+    slot->pts = pts;
+    slot->duration = duration;
+    slot->serial = serial;
+    frameQueue.push();
+    frameCache.setPlayhead(pts);
+    return QueueResult::Queued;
+}
+
+// A picture is late when the clock has already passed the end of its display slot.
+// Nothing is late while paused or before the clock has been anchored after a seek.
+bool VideoPlayer::isFrameLate(double pts) {
+    if (isPaused || clockNeedsAnchor) return false;
+    return masterClock.get() - pts > frameDuration;
+}
+
+// Escalate the decoder skip level under sustained lag and back off once there is headroom
+// again. Evaluated over windows of kSkipWindow pictures so single hiccups do not flip it.
+void VideoPlayer::updateSkipPolicy(double pts, bool late) {
+    if (isPaused || clockNeedsAnchor) return;
+    skipWindowFrames++;
+    if (late) skipWindowLate++;
+    // Decoded comfortably ahead of the clock (the queue is what holds us back)
+    else if (pts - masterClock.get() > frameDuration) skipWindowHeadroom++;
+    if (skipWindowFrames < kSkipWindow) return;
+
+    int level = skipLevel;
+    if (skipWindowLate * 4 > skipWindowFrames && level < kMaxSkipLevel) {
+        applySkipLevel(level + 1);
+    } else if (skipWindowLate == 0 && skipWindowHeadroom * 10 >= skipWindowFrames * 9 && level > 0) {
+        applySkipLevel(level - 1);
+    }
+    skipWindowFrames = skipWindowLate = skipWindowHeadroom = 0;
+}
+
+void VideoPlayer::applySkipLevel(int level) {
+    if (level != skipLevel) skipLevelChanges++;
+    skipLevel = level;
+    CodecCtx->skip_frame = level >= 1 || rateSkipsNonRef ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    CodecCtx->skip_loop_filter = level >= 2 ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+    if (level > 0 || rateSkipsNonRef) cacheAwaitsKeyframe = true;
+}
+
+// Can the renderer take this decoded picture without a swscale pass?
+bool VideoPlayer::canUploadDirectly(const AVFrame* src) {
+    if (src->linesize[0] <= 0) return false; // bottom-up pictures need swscale
+    return (src->format == AV_PIX_FMT_YUV420P && directIYUV) ||
+           (src->format == AV_PIX_FMT_NV12 && directNV12);
+}
+
+// Convert a decoded picture into a queue slot at its display size, reusing the slot's buffer
+// when possible. Pictures the texture takes as-is stay in their YUV layout (half the bytes of
+// RGB24), everything else becomes RGB24. Each thread passes its own scaler (scaler: decode
+// thread, renderScaler: render thread).
+bool VideoPlayer::convertFrame(const AVFrame* src, AVFrame* dst, FrameScaler* frameScaler) {
+    int w, h;
+    scaledSize(src, &w, &h);
+    AVPixelFormat format = canUploadDirectly(src) ? (AVPixelFormat)src->format : AV_PIX_FMT_RGB24;
+    return frameScaler->scale(src, dst, format, w, h, scaleAlgorithm);
+}
+
+// Reduced-resolution decode level for the stream about to be opened (each level halves both
+// dimensions). Automatic mode (opt-in, meant for small preview windows) goes as far down as the
+// codec allows while the decoded picture still covers the display rectangle. Decoders fix lowres
+// when they are opened, so a window enlarged later (e.g. to fullscreen) would be upscaled from
+// the small decode until the next load: normal playback keeps full resolution by default.
+int VideoPlayer::chooseLowres(const AVCodec* codec) {
+    int maxLowres = std::min<int>(codec->max_lowres, kMaxLowres);
+    if (options.lowres >= 0) return std::min(options.lowres, maxLowres);
+    if (displayRect.w <= 0 || displayRect.h <= 0) return 0;
+    int level = 0;
+    while (level < maxLowres &&
+           (CodecCtx->width >> (level + 1)) >= displayRect.w &&
+           (CodecCtx->height >> (level + 1)) >= displayRect.h) {
+        level++;
+    }
+    return level;
+}
+
+// Size a picture should be uploaded at for the current display rectangle (see scaleToBox)
+bool VideoPlayer::scaledSize(const AVFrame* src, int* w, int* h) {
+    uint32_t target = scaleTarget;
+    if (!options.scaleToDisplay) target = 0;
+    return scaleToBox(src->width, src->height, target >> 16, target & 0xffff, canUploadDirectly(src), w, h);
+}
+
+// Fit the picture into the renderer output keeping its aspect ratio (render thread)
+void VideoPlayer::updateDisplayRect(SDL_Renderer* renderer) {
+    int outWidth = 0, outHeight = 0;
+    if (SDL_GetRendererOutputSize(renderer, &outWidth, &outHeight) != 0 || outWidth <= 0 || outHeight <= 0) return;
+    int w = outWidth;
+    int h = static_cast<int>(std::lround(outWidth / displayAspect));
+    if (h > outHeight) {
+        h = outHeight;
+        w = static_cast<int>(std::lround(outHeight * displayAspect));
+    }
+    displayRect = {(outWidth - w) / 2, (outHeight - h) / 2, w, h};
+    // Pictures already queued keep their size; the decoder picks the new one up from here
+    uint32_t targetWidth = std::min(0xffff, (w + kScaleAlign - 1) / kScaleAlign * kScaleAlign);
+    uint32_t targetHeight = std::min(0xffff, (h + kScaleAlign - 1) / kScaleAlign * kScaleAlign);
+    scaleTarget = targetWidth << 16 | targetHeight;
+}
+
+// Letterbox bars plus the current texture, scaled into displayRect
+void VideoPlayer::drawPicture(SDL_Renderer* renderer) {
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    SDL_RenderCopy(renderer, texture, nullptr, &displayRect);
+}
+
+// (Re)create the streaming texture when the picture format or size changes (render thread)
+bool VideoPlayer::ensureTexture(int pixFmt, int w, int h) {
+    Uint32 format = SDL_PIXELFORMAT_RGB24;
+    if (pixFmt == AV_PIX_FMT_YUV420P) format = SDL_PIXELFORMAT_IYUV;
+    else if (pixFmt == AV_PIX_FMT_NV12) format = SDL_PIXELFORMAT_NV12;
+
+    if (texture && format == textureFormat && w == textureWidth && h == textureHeight) return true;
+    if (texture) SDL_DestroyTexture(texture);
+    texture = SDL_CreateTexture(videoRenderer, format, SDL_TEXTUREACCESS_STREAMING, w, h);
+    if (!texture) {
+        std::cerr << "Failed to create video texture: " << SDL_GetError() << std::endl;
+        textureFormat = 0;
+        return false;
+    }
+    textureFormat = format;
+    textureWidth = w;
+    textureHeight = h;
+    return true;
+}
+
+// Copy a queued picture into the texture using the plane layout of its format
+void VideoPlayer::updateTexture(const AVFrame* picture) {
+    if (!ensureTexture(picture->format, picture->width, picture->height)) return;
+    if (textureFormat == SDL_PIXELFORMAT_IYUV) {
+        SDL_UpdateYUVTexture(texture, nullptr,
+            picture->data[0], picture->linesize[0],
+            picture->data[1], picture->linesize[1],
+            picture->data[2], picture->linesize[2]);
+    } else if (textureFormat == SDL_PIXELFORMAT_NV12) {
+        SDL_UpdateNVTexture(texture, nullptr,
+            picture->data[0], picture->linesize[0],
+            picture->data[1], picture->linesize[1]);
+    } else {
+        SDL_UpdateTexture(texture, nullptr, picture->data[0], picture->linesize[0]);
+    }
+}
+
+// Discard queued pictures that were decoded before the latest seek
+void VideoPlayer::dropStaleFrames() {
+    int serial = videoQueue.getSerial();
+    FrameQueue::Frame* queued;
+    while ((queued = frameQueue.peekReadable()) && queued->serial != serial) {
+        frameQueue.next();
+    }
+}
+
+// Present the picture that is due according to the master clock. Pictures that are not due
+// yet leave the current texture on screen; pictures that are already late are skipped.
+bool VideoPlayer::uploadNextFrame() {
+    dropStaleFrames();
+    // Whatever is still queued belongs to the old position; wait for the demuxer to flush it
+    if (seekPending()) return false;
+
+    FrameQueue::Frame* next = frameQueue.peekReadable();
+    if (next && clockNeedsAnchor) {
+        // First picture after load/seek defines "now" until the audio clock takes over
+        masterClock.set(next->pts);
+        clockNeedsAnchor = false;
+    }
+    double clock = getMasterClock();
+    // The clock when this frame actually reaches the screen, plus half a vsync so each picture
+    // goes up on the vsync nearest to its timestamp rather than the first one after it
+    double displayClock = clock + presentLead * playbackRate;
+    double dueClock = displayClock + vsyncInterval * 0.5 * playbackRate;
+    if (!next) {
+        // Decoder is behind: the current picture overstays its slot
+        if (haveFrame && clock > displayedUntil && !scrubbing) {
+            stats.framesRepeated++;
+            displayedUntil += frameDuration;
+        }
+        return false;
+    }
+
+    double delay = next->pts - dueClock;
+    if (delay > kMaxFrameDelay && !audioDrivesClock) {
+        // Timestamp jump (or a clock left behind): follow the video instead of freezing
+        masterClock.set(next->pts);
+        displayClock = dueClock = next->pts;
+        delay = 0.0;
+    }
+    if (delay > 0.0) return false; // Not due yet: repeat the current picture
+
+    // Late: skip every picture whose successor is already due as well
+    FrameQueue::Frame* after;
+    while ((after = frameQueue.peekNextReadable()) && after->serial == next->serial && after->pts <= dueClock) {
+        frameQueue.next();
+        stats.framesDropped++;
+        next = frameQueue.peekReadable();
+    }
+
+    updateTexture(next->frame);
+    if (stats.framesPresented == 0) stats.firstFrameMs = (Clock::now() - loadStartedAt) * 1000.0;
+    // While scrubbing the timeline keeps showing where the user points, not the keyframe
+    if (scrubbing) scrubAwaitingFrame = false;
+    else currentPts = next->pts;
+    displayedUntil = next->pts + (next->duration > 0.0 ? next->duration : frameDuration);
+    haveFrame = true;
+
+    // Sync report: positive drift means the picture went up early, negative means late
+    double drift = next->pts - displayClock;
+    stats.framesPresented++;
+    stats.drift = drift;
+    stats.avgDrift = stats.avgDrift * 0.95 + std::fabs(drift) * 0.05;
+    if (std::fabs(drift) > stats.maxDrift) stats.maxDrift = std::fabs(drift);
+
+    frameQueue.next();
+    return true;
+}
+
+// Current playback position according to the master clock (render thread).
+// While the audio callback keeps timing fresh sound of the current serial, the clock is
+// re-synced to the audio playhead; otherwise it free-runs on the system clock.
+double VideoPlayer::getMasterClock() {
+    audioDrivesClock = false;
+    if (audioDevice && !isPaused && !seekPending() &&
+        audioClockSerial == audioQueue.getSerial() &&
+        Clock::now() - audioClockUpdatedAt < kAudioClockStale) {
+        masterClock.set(readAudioClock());
+        audioDrivesClock = true;
+    }
+    stats.audioMaster = audioDrivesClock;
+    return masterClock.get();
+}
+
+// Audio playhead extrapolated to now (only meaningful while the device is playing)
+double VideoPlayer::readAudioClock() const {
+    unsigned before, after;
+    double pts, rate, updatedAt;
+    do {
+        before = audioClockSeq;
+        pts = audioClockPts;
+        rate = audioClockRate;
+        updatedAt = audioClockUpdatedAt;
+        after = audioClockSeq;
+    } while ((before & 1) || before != after);
+    return pts + (Clock::now() - updatedAt) * rate;
+}
+
+// How long the render loop may sleep before the next picture has to go up
+double VideoPlayer::getTimeUntilNextFrame() {
+    if (isPaused || !fmtCtx || reverse) return -1.0;
+    FrameQueue::Frame* next = frameQueue.peekReadable();
+    if (!next || clockNeedsAnchor) return -1.0;
+    // Media time runs playbackRate times as fast as the wall clock; a picture is due half a
+    // vsync early (see uploadNextFrame), the vsync present itself waits for the exact moment
+    double delay = (next->pts - getMasterClock()) / playbackRate - vsyncInterval * 0.5;
+    return delay > 0.0 ? delay : 0.0;
+}
+
+void VideoPlayer::setPresentTiming(double lead, double refreshInterval) {
+    presentLead = lead > 0.0 ? lead : 0.0;
+    vsyncInterval = refreshInterval > 0.0 ? refreshInterval : 0.0;
+}
+
+bool VideoPlayer::hasNewPicture() const {
+    return frameReady;
+}
+
+double VideoPlayer::getFrameInterval() {
+    if (!fmtCtx || isPaused) return 0.0;
+    return frameDuration / playbackRate;
+}
+
+// Whether renderFrame() has work to do without any input: the picture changes on its own while
+// playing, and a seek, step or scrub issued while paused still has to put its picture up
+bool VideoPlayer::needsRefresh() {
+    if (!fmtCtx) return false;
+    if (!isPaused) return true;
+    return pendingStep != 0 || clockNeedsAnchor || scrubbing || seekPending();
+}
+
+VideoPlayer::PlaybackStats VideoPlayer::getStats() {
+    PlaybackStats current = stats;
+    current.lateDropped = lateFramesDropped;
+    current.skipLevel = skipLevel;
+    current.skipLevelChanges = skipLevelChanges;
+    switch (keyframeIndex.getSource()) {
+        case KeyframeIndex::Source::Container: current.keyframeIndex = "container"; break;
+        case KeyframeIndex::Source::Scan:
+            current.keyframeIndex = keyframeIndex.isComplete() ? "scan" : "scanning"; break;
+        default: current.keyframeIndex = "none"; break;
+    }
+    current.keyframes = static_cast<int>(keyframeIndex.size());
+    current.lastSeekKeyframeGap = seekKeyframeGap;
+    current.lastSeekCatchupFrames = seekCatchupFrames;
+    current.lastSeekCatchupMs = seekCatchupMs;
+    current.seeksCoalesced = seeksCoalesced;
+    current.seeksAbandoned = seeksAbandoned;
+    current.cacheHits = cacheHits;
+    current.framesFromCache = framesFromCache;
+    current.cachedFrames = static_cast<int>(frameCache.getCount());
+    current.cacheMB = frameCache.getByteSize() / (1024.0 * 1024.0);
+    current.reverse = reverse;
+    current.reverseBufferMB = reverseDecoder.getByteSize() / (1024.0 * 1024.0);
+    current.reverseRedecodes = reverseDecoder.getRedecodes();
+    current.playbackRate = playbackRate;
+    MmapIO::Stats io = mmapIO.getStats();
+    current.mmapIO = mmapIO.isOpen();
+    current.ioReads = io.reads;
+    current.ioSeeks = io.seeks;
+    current.ioMB = io.bytesRead / (1024.0 * 1024.0);
+    if (prefetchIO.isOpen()) {
+        PrefetchIO::Stats prefetch = prefetchIO.getStats();
+        current.prefetch = prefetch.backend;
+        current.prefetchReads = prefetch.reads;
+        current.prefetchStalls = prefetch.stalls;
+        current.prefetchStallMs = prefetch.stallMs;
+        current.prefetchRetargets = prefetch.retargets;
+    }
+    current.rateSkip = rateSkipsNonRef;
+    current.outputWidth = textureWidth;
+    current.outputHeight = textureHeight;
+    current.scaler = scaleAlgorithmName(scaleAlgorithm);
+    current.scaleThreads = scaler.getActiveThreads();
+    current.lowres = CodecCtx ? CodecCtx->lowres : 0;
+    current.decodeWidth = width;
+    current.decodeHeight = height;
+    return current;
+}
+
+void VideoPlayer::setOptions(const Options& newOptions) {
+    options = newOptions;
+}
+
+const VideoPlayer::Options& VideoPlayer::getOptions() const {
+    return options;
+}
+
+// Read on the main thread only (load, reverse start): no need to stop the workers for it
+void VideoPlayer::setInputOptions(const InputOptions& input) {
+    options.input = input;
+}
+
+// Only chooseLowres reads it, while load() opens the decoder
+void VideoPlayer::setLowres(int level) {
+    options.lowres = level;
+}
+
+// Start presentation over: the next picture re-anchors the clock
+void VideoPlayer::resetClock() {
+    clockNeedsAnchor = true;
+    haveFrame = false;
+}
+
+void VideoPlayer::startAudioDecoder() {
+    if (!AudioCodecCtx || !audioDevice) return;
+    audioDecodeAbort = false;
+    audioDecodeThread = std::thread(&VideoPlayer::audioDecodeLoop, this);
+}
+
+void VideoPlayer::stopAudioDecoder() {
+    audioDecodeAbort = true;
+    if (audioDecodeThread.joinable()) audioDecodeThread.join();
+}
+
+// Audio decode thread: decodes audio packets and keeps the ring buffer topped up.
+// Blocks (sleeping) while the ring is full, i.e. while the device has enough to play.
+void VideoPlayer::audioDecodeLoop() {
+    AVPacket* pkt = av_packet_alloc();
+    AVRational timeBase = fmtCtx->streams[audioStreamIndex]->time_base;
+    double writtenEnd = -1.0; // pts just past the last sample written (<0: unknown)
+    int serial = 0;
+    bool scrubSilent = false;
+    bool anchored = false;    // ring timeline has an anchor for the current serial and rate
+
+    while (!audioDecodeAbort) {
+        if (!audioQueue.get(pkt, &serial, 10)) continue;
+
+        // After a seek, throw away decoder state and sound that belongs to the old position
+        if (serial != audioSerial) {
+            avcodec_flush_buffers(AudioCodecCtx);
+            SDL_LockAudioDevice(audioDevice); // keeps the callback out while the ring is reset
+            audioRing.clear();
+            {
+                std::lock_guard<std::mutex> lock(ringAnchorMutex);
+                ringAnchors.clear();
             }
+            ringSerial = serial;
+            SDL_UnlockAudioDevice(audioDevice);
+            audioSerial = serial;
+            audioSeekTarget = seekTargetForSerial(serial, &scrubSilent);
+            writtenEnd = -1.0;
+            stretcher.reset();
+            anchored = false;
+            // Samples still buffered inside the resampler belong to the old position
+            if (swrCtx) swr_init(swrCtx);
         }
-        av_packet_unref(packet); // Always unref the packet after processing (FFmpeg requirement)
+        // Scrub previews are silent
+        if (scrubSilent || newerSeekPending()) { av_packet_unref(pkt); continue; }
+        avcodec_send_packet(AudioCodecCtx, pkt);
+        av_packet_unref(pkt);
+
+        while (!audioDecodeAbort && avcodec_receive_frame(AudioCodecCtx, audioFrame) == 0) {
+            // Where this frame sits on the timeline (extrapolate when the decoder gives no pts)
+            double frameStart = writtenEnd;
+            if (audioFrame->best_effort_timestamp != AV_NOPTS_VALUE) {
+                frameStart = audioFrame->best_effort_timestamp * av_q2d(timeBase);
+            }
+            double frameEnd = frameStart + (double)audioFrame->nb_samples / AudioCodecCtx->sample_rate;
+            // Sound before a seek target would make the clock start early: drop it
+            if (audioSeekTarget >= 0.0 && frameStart >= 0.0 && frameEnd < audioSeekTarget) continue;
+            audioSeekTarget = -1.0;
+
+            // Bring any sample format/layout/rate to the device format in one pass
+            const uint8_t* pcm = nullptr;
+            size_t pcmSize = 0;
+            if (!resampleAudio(audioFrame, &pcm, &pcmSize)) continue;
+            // A rate change carries on from the input the stretcher holds; what is already in the
+            // ring plays out at the old rate
+            double rate = playbackRate;
+            if (rate != stretcher.getRate()) {
+                stretcher.setRate(rate);
+                // The next byte written plays the stretcher's first unconsumed input
+                if (anchored && writtenEnd >= 0.0) anchorRing(writtenEnd - stretcher.getBufferedSeconds(), rate);
+                else anchored = false;
+            }
+            // The first sound after a (re)start or rate change anchors the ring's timeline
+            if (!anchored && frameStart >= 0.0) {
+                anchorRing(frameStart, rate);
+                anchored = true;
+            }
+            // Faster/slower than 1x: change the tempo, keep the pitch
+            pcmSize = stretcher.process(pcm, pcmSize, &pcm);
+            if (!writeAudio(pcm, pcmSize, serial)) break;
+            writtenEnd = frameEnd;
+        }
+    }
+    av_packet_free(&pkt);
+}
+
+// Convert a decoded audio frame to the device format. Frames that already match are passed
+// through untouched; otherwise the cached SwrContext converts into the reusable resampleBuffer.
+bool VideoPlayer::resampleAudio(const AVFrame* in, const uint8_t** out, size_t* outSize) {
+    AVSampleFormat inFmt = (AVSampleFormat)in->format;
+    AVChannelLayout inLayout = {};
+    // Some decoders only report a channel count; assume the usual layout for it
+    if (in->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC) av_channel_layout_default(&inLayout, in->ch_layout.nb_channels);
+    else av_channel_layout_copy(&inLayout, &in->ch_layout);
+
+    if (inFmt == deviceSampleFmt && in->sample_rate == audioSpec.freq &&
+        av_channel_layout_compare(&inLayout, &deviceLayout) == 0) {
+        av_channel_layout_uninit(&inLayout);
+        *out = in->data[0];
+        *outSize = static_cast<size_t>(in->nb_samples) * deviceBytesPerFrame;
+        return true;
     }
+
+    // (Re)build the converter only when the decoder output changes
+    if (!swrCtx || inFmt != swrInFmt || in->sample_rate != swrInRate ||
+        av_channel_layout_compare(&inLayout, &swrInLayout) != 0) {
+        swr_free(&swrCtx);
+        if (swr_alloc_set_opts2(&swrCtx, &deviceLayout, deviceSampleFmt, audioSpec.freq,
+                                &inLayout, inFmt, in->sample_rate, 0, nullptr) < 0 ||
+            swr_init(swrCtx) < 0) {
+            std::cerr << "Failed to set up audio resampler\n";
+            swr_free(&swrCtx);
+            av_channel_layout_uninit(&inLayout);
+            return false;
+        }
+        swrInFmt = inFmt;
+        swrInRate = in->sample_rate;
+        av_channel_layout_uninit(&swrInLayout);
+        av_channel_layout_copy(&swrInLayout, &inLayout);
+    }
+    av_channel_layout_uninit(&inLayout);
+
+    int maxSamples = swr_get_out_samples(swrCtx, in->nb_samples);
+    if (maxSamples <= 0) return false;
+    size_t needed = static_cast<size_t>(maxSamples) * deviceBytesPerFrame;
+    if (resampleBuffer.size() < needed) resampleBuffer.resize(needed);
+
+    uint8_t* dst = resampleBuffer.data();
+    int converted = swr_convert(swrCtx, &dst, maxSamples, (const uint8_t**)in->extended_data, in->nb_samples);
+    if (converted < 0) return false;
+    *out = resampleBuffer.data();
+    *outSize = static_cast<size_t>(converted) * deviceBytesPerFrame;
+    return true;
+}
+
+// Start a new stretch of the ring timeline at the next byte the decoder writes
+void VideoPlayer::anchorRing(double pts, double rate) {
+    std::lock_guard<std::mutex> lock(ringAnchorMutex);
+    ringAnchors.push_back({audioRing.totalWritten(), pts, rate});
+}
+
+// Push PCM into the ring, waiting for the callback to make room. Gives up (returns false)
+// on shutdown or when a seek makes this audio obsolete.
+bool VideoPlayer::writeAudio(const uint8_t* data, size_t size, int serial) {
+    while (size > 0) {
+        size_t written = audioRing.write(data, size);
+        data += written;
+        size -= written;
+        if (size == 0) break;
+        if (audioDecodeAbort || audioQueue.getSerial() != serial) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+}
+
+// SDL audio callback (runs on SDL's audio thread)
+void VideoPlayer::audioCallback(void* userdata, Uint8* stream, int len) {
+    static_cast<VideoPlayer*>(userdata)->fillAudio(stream, len);
+}
+
+// Drain the ring into the device buffer, apply volume, and time-stamp what is being played
+void VideoPlayer::fillAudio(Uint8* stream, int len) {
+    size_t got = audioRing.read(stream, len);
+    // Ramp from the gain of the previous buffer to the requested volume across this one,
+    // so a volume change never steps in the middle of a waveform (zipper noise)
+    float target = volume;
+    if (audioSpec.format == AUDIO_F32SYS) {
+        applyGainFloat((float*)stream, got / sizeof(float), appliedGain, target);
+    } else {
+        applyGainS16((int16_t*)stream, got / sizeof(int16_t), appliedGain, target);
+    }
+    if (got > 0) appliedGain = target;
+    // Underrun: pad with silence instead of leaving stale bytes
+    if (got < static_cast<size_t>(len)) SDL_memset(stream + got, audioSpec.silence, len - got);
+
+    if (got == 0) return;
+    // Never wait for the decoder here: if it is adding an anchor, the next buffer gets timed instead
+    std::unique_lock<std::mutex> lock(ringAnchorMutex, std::try_to_lock);
+    if (!lock.owns_lock() || ringAnchors.empty()) return;
+    // The chunk just handed over plays after the one the device is playing right now
+    double playing = (double)audioRing.totalRead() - 2.0 * len;
+    while (ringAnchors.size() > 1 && ringAnchors[1].byte <= playing) ringAnchors.pop_front();
+    const RingAnchor& anchor = ringAnchors.front();
+    // The render thread reads these lock-free (only this callback ever writes them)
+    unsigned seq = audioClockSeq;
+    audioClockSeq = seq + 1;
+    audioClockPts = anchor.pts + (playing - anchor.byte) / audioBytesPerSec * anchor.rate;
+    audioClockRate = anchor.rate;
+    audioClockUpdatedAt = Clock::now();
+    audioClockSeq = seq + 2;
+    audioClockSerial = ringSerial.load();
 }
 
 // Render the current video frame to the SDL window (draws last decoded frame or decodes new one)
 void VideoPlayer::renderFrame(SDL_Renderer* renderer) {
-    if (isPaused) {
+    updateDisplayRect(renderer); // follows window resizes
+    if (reverse) {
+        if (!isPaused) frameReady = uploadReverseFrame();
+        drawPicture(renderer);
+        return;
+    }
+    if (scrubbing) pumpScrub();
+    if (pendingStep != 0) {
+        serveStep();
+        drawPicture(renderer);
+        return;
+    }
+    // A seek while paused still puts its first picture up
+    if (isPaused && !clockNeedsAnchor) {
         // If paused, simply blit the current texture to the screen
-        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+        dropStaleFrames(); // still free slots of a seek so the decoder can move on
+        drawPicture(renderer);
         return;
     }
-    if (!frameReady) decodeNextFrame(); // If not ready, decode a new frame (may update frameReady)
-    SDL_RenderCopy(renderer, texture, nullptr, nullptr); // Display current frame
-    frameReady = false; // Mark frame as stale; will decode next one on next call
+    frameReady = uploadNextFrame(); // Take the next decoded picture, if the decoder has one
+    drawPicture(renderer); // Display current frame
 }
 
 // Seek forward/backward by a certain number of seconds (relative seek)
 void VideoPlayer::seek(float seconds) {
     if (!fmtCtx || videoStreamIndex < 0) return;
-    AVStream* stream = fmtCtx->streams[videoStreamIndex];
     float newTime = getcurrentTime() + seconds;
     if (newTime < 0) newTime = 0;
     float duration = getDuration();
     if (newTime > duration) newTime = duration - 0.01f; // Clamp
-    // Calculate the corresponding PTS in stream's time_base units
-    int64_t targetTimestamp = av_rescale_q(
-        static_cast<int64_t>(newTime * AV_TIME_BASE),
-        AV_TIME_BASE_Q, stream->time_base
-    );
-    // Instruct FFmpeg to seek
-    av_seek_frame(fmtCtx, videoStreamIndex, targetTimestamp, AVSEEK_FLAG_BACKWARD);
-    avcodec_flush_buffers(CodecCtx); // Discard all already-decoded data
-    if (AudioCodecCtx) avcodec_flush_buffers(AudioCodecCtx);
-    seekTargetTime = newTime;  // Set the target time for frame-accurate seeking in decodeNextFrame
+    if (reverse) {
+        // Restart the backwards walk from the new position
+        currentPts = newTime;
+        startReverse(newTime);
+        return;
+    }
+    // The demux thread performs the actual av_seek_frame; decoders flush when they see the new serial
+    requestSeek(newTime);
+    currentPts = newTime; // Report the target right away so the timeline does not jump back
+    resetClock();
     frameReady = false;
 }
 
 // Seek to a specific time in the video, in seconds (absolute seek)
 void VideoPlayer::seekTo(float time) {
     if (!fmtCtx || videoStreamIndex < 0) return;
-    AVStream* stream = fmtCtx->streams[videoStreamIndex];
-    float seekTime = time;
-    if (seekTime < 0) seekTime = 0;
+    float seekTime = clampSeekTime(time);
+    if (reverse) {
+        currentPts = seekTime;
+        startReverse(seekTime);
+        return;
+    }
+    requestSeek(seekTime);
+    currentPts = seekTime;
+    resetClock();
+    frameReady = false;
+}
+
+float VideoPlayer::clampSeekTime(float time) {
+    if (time < 0) time = 0;
     float duration = getDuration();
-    if (seekTime > duration) seekTime = duration - 0.01f;
-    int64_t targetTimestamp = av_rescale_q(
-        static_cast<int64_t>(seekTime * AV_TIME_BASE),
-        AV_TIME_BASE_Q, stream->time_base
-    );
-    av_seek_frame(fmtCtx, videoStreamIndex, targetTimestamp, AVSEEK_FLAG_BACKWARD);
-    avcodec_flush_buffers(CodecCtx);
-    if (AudioCodecCtx) avcodec_flush_buffers(AudioCodecCtx);
-    seekTargetTime = seekTime;
+    if (time > duration) time = duration - 0.01f;
+    return time;
+}
+
+// Slider grabbed: mute until it is released
+void VideoPlayer::beginScrub() {
+    if (!fmtCtx || videoStreamIndex < 0 || scrubbing) return;
+    if (reverse) setReverse(false); // previews come from the forward pipeline
+    scrubbing = true;
+    scrubTarget = scrubIssued = -1.0;
+    scrubAwaitingFrame = false;
+    if (audioDevice) SDL_PauseAudioDevice(audioDevice, 1);
+}
+
+// Slider moved: remember the position; pumpScrub() decides when to actually seek there
+void VideoPlayer::scrubTo(float time) {
+    if (!fmtCtx || videoStreamIndex < 0) return;
+    if (!scrubbing) beginScrub();
+    scrubTarget = clampSeekTime(time);
+    currentPts = scrubTarget;
+    pumpScrub();
+}
+
+// Send the latest slider position to the demuxer as a keyframe-only seek. Positions that
+// arrive while the previous preview is still decoding are coalesced into the newest one.
+void VideoPlayer::pumpScrub() {
+    if (scrubTarget < 0.0 || scrubTarget == scrubIssued) return;
+    if (scrubAwaitingFrame && Clock::now() - scrubIssuedAt < kScrubRetry) return;
+    requestSeek(scrubTarget, true);
+    scrubIssued = scrubTarget;
+    scrubIssuedAt = Clock::now();
+    scrubAwaitingFrame = true;
+    resetClock();
     frameReady = false;
 }
 
+// Slider released: one frame-accurate seek to where it ended up
+void VideoPlayer::endScrub(float time) {
+    if (!scrubbing) return;
+    scrubbing = false;
+    seekTo(time);
+    if (audioDevice && !isPaused) SDL_PauseAudioDevice(audioDevice, 0);
+}
+
+void VideoPlayer::cancelScrub() {
+    if (!scrubbing) return;
+    scrubbing = false;
+    if (audioDevice && !isPaused) SDL_PauseAudioDevice(audioDevice, 0);
+}
+
+bool VideoPlayer::isScrubbing() const {
+    return scrubbing;
+}
+
 // Get the current playback time, in seconds
 float VideoPlayer::getcurrentTime() {
     return static_cast<float>(currentPts);
@@ -262,13 +1277,210 @@ float VideoPlayer::getDuration() {
 // Toggle video playback (pause/resume), and pause/resume audio if available
 void VideoPlayer::togglePause() {
     isPaused = !isPaused;
-    if (AudioCodecCtx && audioDevice) 
+    pendingStep = 0;
+    reverseClock.setPaused(isPaused);
+    // After stepping through cached pictures the queue holds pictures from elsewhere:
+    // restart from what is on screen (a cache hit, so this costs no decoding)
+    if (!isPaused && stepLeftQueue && !reverse) {
+        stepLeftQueue = false;
+        seekTo(static_cast<float>(currentPts));
+    }
+    masterClock.setPaused(isPaused);
+    if (AudioCodecCtx && audioDevice && !reverse) 
         SDL_PauseAudioDevice(audioDevice, isPaused ? 1 : 0);
 }
 
 // Is playback currently paused?
 bool VideoPlayer::getPauseState() { return isPaused; }
 
+void VideoPlayer::setReverse(bool enable) {
+    if (!fmtCtx || videoStreamIndex < 0 || enable == reverse) return;
+    if (enable) {
+        reverse = true;
+        pendingStep = 0;
+        if (audioDevice) SDL_PauseAudioDevice(audioDevice, 1); // no reverse audio
+        startReverse(currentPts);
+        return;
+    }
+    reverse = false;
+    reverseDecoder.stop();
+    // Forward playback picks up from the picture on screen
+    seekTo(static_cast<float>(currentPts));
+    if (audioDevice && !isPaused) SDL_PauseAudioDevice(audioDevice, 0);
+}
+
+bool VideoPlayer::isReverse() const {
+    return reverse;
+}
+
+// Change the playback speed. The system clocks switch pace at once; the audio clock follows
+// when the sound already buffered at the old rate has played out.
+void VideoPlayer::setPlaybackRate(float rate) {
+    rate = std::clamp(rate, kMinPlaybackRate, kMaxPlaybackRate);
+    playbackRate = rate;
+    masterClock.setRate(rate);
+    reverseClock.setRate(rate);
+}
+
+float VideoPlayer::getPlaybackRate() const {
+    return playbackRate;
+}
+
+void VideoPlayer::setScaleAlgorithm(ScaleAlgorithm algorithm) {
+    scaleAlgorithm = algorithm;
+}
+
+ScaleAlgorithm VideoPlayer::getScaleAlgorithm() const {
+    return scaleAlgorithm;
+}
+
+// (Re)start the backwards walk just before `from`; the clock is anchored on its first picture
+void VideoPlayer::startReverse(double from) {
+    if (!reverseDecoder.start(loadedPath, videoStreamIndex, from, options.input, options.videoThreading,
+                              CodecCtx->lowres, &keyframeIndex, options.reverseBufferBytes)) {
+        std::cerr << "Failed to start reverse playback\n";
+        reverse = false;
+        seekTo(static_cast<float>(from));
+        if (audioDevice && !isPaused) SDL_PauseAudioDevice(audioDevice, 0);
+        return;
+    }
+    reverseAnchored = false;
+    reverseClock.setPaused(isPaused);
+}
+
+// Reverse counterpart of uploadNextFrame(): the playhead moves towards the start, and a picture
+// is due once it has reached the end of that picture's display slot
+bool VideoPlayer::uploadReverseFrame() {
+    ReverseDecoder::Picture picture;
+    if (!reverseDecoder.peek(&picture)) return false;
+    double duration = picture.duration > 0.0 ? picture.duration : frameDuration;
+    if (!reverseAnchored) {
+        reverseOrigin = picture.pts + duration;
+        reverseClock.set(0.0);
+        reverseAnchored = true;
+    }
+    double position = reverseOrigin - reverseClock.get();
+    // Worker fell far behind (first GOP of a long file, disk stall): continue from here
+    if (picture.pts + duration - position > kMaxFrameDelay) {
+        reverseOrigin = picture.pts + duration;
+        reverseClock.set(0.0);
+        position = reverseOrigin;
+    }
+    if (position > picture.pts + duration) return false; // not due yet
+
+    // Late: skip pictures whose (older) successor is already due as well
+    ReverseDecoder::Picture older;
+    while (reverseDecoder.peekNext(&older) &&
+           position <= older.pts + (older.duration > 0.0 ? older.duration : frameDuration)) {
+        reverseDecoder.pop();
+        stats.framesDropped++;
+        picture = older;
+    }
+    uploadNativePicture(picture.frame);
+    currentPts = picture.pts;
+    stats.framesPresented++;
+    reverseDecoder.pop();
+    return true;
+}
+
+// Show the next picture. Pauses first, so a step always starts from a frozen picture.
+void VideoPlayer::stepForward() {
+    if (!fmtCtx || videoStreamIndex < 0 || pendingStep != 0 || reverse) return;
+    if (!isPaused) togglePause();
+    pendingStep = 1;
+    stepRequestedAt = Clock::now();
+    serveStep();
+}
+
+// Show the previous picture
+void VideoPlayer::stepBackward() {
+    if (!fmtCtx || videoStreamIndex < 0 || pendingStep != 0 || reverse) return;
+    if (!isPaused) togglePause();
+    pendingStep = -1;
+    stepSeeked = false;
+    stepRequestedAt = Clock::now();
+    serveStep();
+}
+
+// Try to complete the pending step; called again every render pass until it succeeds
+void VideoPlayer::serveStep() {
+    if (!stepFrame) stepFrame = av_frame_alloc();
+    double pts = 0.0, duration = 0.0;
+
+    if (pendingStep > 0) {
+        // The cache knows the next picture when we stepped back into it earlier
+        bool cachedNext = frameCache.fetchNext(currentPts, stepFrame, &pts, &duration);
+        FrameQueue::Frame* next = nullptr;
+        dropStaleFrames();
+        if (!seekPending()) {
+            // Otherwise it is the first queued picture past the one on screen
+            while ((next = frameQueue.peekReadable()) && next->pts <= currentPts) frameQueue.next();
+        }
+        // Prefer the queue when it holds the same picture, so playback can simply carry on
+        if (next && (!cachedNext || next->pts <= pts)) {
+            av_frame_unref(stepFrame);
+            presentStep(next->frame, next->pts, next->duration);
+            frameQueue.next();
+            stepLeftQueue = false;
+            return;
+        }
+        if (cachedNext) {
+            presentStep(stepFrame, pts, duration);
+            stepLeftQueue = true;
+        }
+        return; // neither has it yet: the decoder is still on its way
+    }
+
+    if (!stepSeeked) {
+        if (frameCache.fetchPrevious(currentPts, stepFrame, &pts, &duration)) {
+            presentStep(stepFrame, pts, duration);
+            stepLeftQueue = true;
+            return;
+        }
+        // Not cached: decode the GOP up to the previous picture. Every picture decoded on the
+        // way lands in the cache, so the following steps back are served from there.
+        requestSeek(std::max(0.0, currentPts - frameDuration * 0.5));
+        stepSeeked = true;
+        return;
+    }
+    dropStaleFrames();
+    if (seekPending()) return;
+    FrameQueue::Frame* previous = frameQueue.peekReadable();
+    if (!previous) return;
+    presentStep(previous->frame, previous->pts, previous->duration);
+    frameQueue.next();
+    stepSeeked = false;
+    stepLeftQueue = false;
+}
+
+// Upload a picture that may still be in the decoder's format (cached or reverse pictures)
+void VideoPlayer::uploadNativePicture(const AVFrame* picture) {
+    int w, h;
+    bool shrink = scaledSize(picture, &w, &h);
+    if (!shrink && (canUploadDirectly(picture) || picture->format == AV_PIX_FMT_RGB24)) {
+        updateTexture(picture);
+        return;
+    }
+    if (!renderRgb) renderRgb = av_frame_alloc();
+    if (convertFrame(picture, renderRgb, &renderScaler)) updateTexture(renderRgb);
+}
+
+void VideoPlayer::presentStep(const AVFrame* picture, double pts, double duration) {
+    uploadNativePicture(picture);
+    if (picture == stepFrame) av_frame_unref(stepFrame);
+
+    currentPts = pts;
+    masterClock.set(pts);   // paused: playback resumes from here
+    displayedUntil = pts + (duration > 0.0 ? duration : frameDuration);
+    haveFrame = true;
+    clockNeedsAnchor = false;
+    frameCache.setPlayhead(pts);
+
+    stats.steps++;
+    stats.lastStepMs = (Clock::now() - stepRequestedAt) * 1000.0;
+    pendingStep = 0;
+}
+
 //volume control
 // Set the volume level (0.0 to 2.0)
 void VideoPlayer::changeVolume(float diffVolume , bool setDefault){
@@ -280,14 +1492,11 @@ void VideoPlayer::changeVolume(float diffVolume , bool setDefault){
         volume = 1.0f; // Reset to default volume
         }
     }else{
-        volume += diffVolume; 
+        volume = volume + diffVolume; 
         if (volume < 0.0f) volume = 0.0f; // Clamp to minimum
         else if (volume > 2.0f) volume = 2.0f; // Clamp to maximum
     }
-     if (audioDevice){
-        SDL_ClearQueuedAudio(audioDevice);
-     }
-
+    // Nothing to flush: the audio callback applies the new volume to the next buffer it plays
 }
 
 
@@ -296,16 +1505,36 @@ void VideoPlayer::changeVolume(float diffVolume , bool setDefault){
 
 // Cleanup all dynamically allocated resources for this file
 void VideoPlayer::cleanup() {
-    if (packet) av_packet_free(&packet);
-    if (frame) av_frame_free(&frame);
-    if (rgbFrame) { av_free(rgbFrame->data[0]); av_frame_free(&rgbFrame); }
+    // Worker threads must be gone before the contexts they use are freed
+    stopAudioDecoder();
+    stopVideoDecoder();
+    stopDemuxer();
+    reverseDecoder.close();
+    reverse = false;
+    keyframeIndex.clear();
+    frameCache.clear();
     if (texture) { SDL_DestroyTexture(texture); texture = nullptr; }
+    textureFormat = 0;
+    textureWidth = textureHeight = 0;
     if (CodecCtx) avcodec_free_context(&CodecCtx);
     if (fmtCtx) avformat_close_input(&fmtCtx);
-    if (swsCtx) sws_freeContext(swsCtx);
-    if (audioDevice) SDL_CloseAudioDevice(audioDevice);
+    mmapIO.close(); // custom I/O is not freed by avformat_close_input
+    prefetchIO.close();
+    scaler.reset();
+    renderScaler.reset();
+    if (stepFrame) av_frame_free(&stepFrame);
+    if (renderRgb) av_frame_free(&renderRgb);
+    pendingStep = 0;
+    stepSeeked = false;
+    stepLeftQueue = false;
+    if (audioDevice) SDL_CloseAudioDevice(audioDevice); // also waits out a running callback
     if (AudioCodecCtx) avcodec_free_context(&AudioCodecCtx);
     if (audioFrame) av_frame_free(&audioFrame);
+    if (swrCtx) swr_free(&swrCtx);
+    av_channel_layout_uninit(&swrInLayout);
+    av_channel_layout_uninit(&deviceLayout);
+    swrInFmt = AV_SAMPLE_FMT_NONE;
+    swrInRate = 0;
     audioDevice = 0;
     AudioCodecCtx = nullptr;
     audioFrame = nullptr;
@@ -1,7 +1,28 @@
 #pragma once
 
 #include <SDL2/SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include "AudioRingBuffer.h"
+#include "Clock.h"
+#include "DecoderConfig.h"
+#include "FrameCache.h"
+#include "FrameQueue.h"
+#include "FrameScaler.h"
+#include "InputOpener.h"
+#include "KeyframeIndex.h"
+#include "MmapIO.h"
+#include "PacketQueue.h"
+#include "PrefetchIO.h"
+#include "ReverseDecoder.h"
+#include "StreamInfoCache.h"
+#include "TimeStretcher.h"
 
 
 extern "C"{
@@ -19,44 +40,353 @@ class VideoPlayer
 {
 private:
     AVFormatContext* fmtCtx = nullptr;
+    MmapIO mmapIO;   // fmtCtx->pb when InputOptions::mmapIO is on and the file could be mapped
+    PrefetchIO prefetchIO; // fmtCtx->pb when InputOptions::prefetchBytes is set (and mmap is not used)
+    StreamInfoCache streamInfoCache;
+    double loadStartedAt = 0.0;     // for the time-to-first-frame stat
+    double openMs = 0.0;
+    const char* streamInfoSource = "probe";
+    bool openStream(const std::string& filepath);
     AVCodecContext* CodecCtx = nullptr;
-    AVFrame* frame = nullptr;
-    AVFrame* rgbFrame = nullptr;
-    AVPacket* packet = nullptr;//
-    struct SwsContext* swsCtx = nullptr;//
+    FrameScaler scaler;     // video decode thread
     SDL_Texture* texture = nullptr;//
+    SDL_Renderer* videoRenderer = nullptr;
+    Uint32 textureFormat = 0;
+    int textureWidth = 0, textureHeight = 0;
+    // Scale-on-decode: pictures are converted at the size of the letterboxed display rectangle
+    // (never above the source size) instead of at full resolution for SDL to shrink
+    SDL_Rect displayRect{0, 0, 0, 0};       // where the picture goes in the window (render thread)
+    double displayAspect = 1.0;             // picture aspect ratio including the sample aspect ratio
+    std::atomic<uint32_t> scaleTarget{0};   // width << 16 | height of displayRect, 0: unknown (decode thread reads)
+    std::atomic<ScaleAlgorithm> scaleAlgorithm{ScaleAlgorithm::Bilinear};
+    void updateDisplayRect(SDL_Renderer* renderer);
+    bool scaledSize(const AVFrame* src, int* w, int* h); // true when the picture is to be shrunk
+    void drawPicture(SDL_Renderer* renderer);
+    // Lowres decoding (codecs with AVCodec::max_lowres: MPEG-1/2/4, H.263, MJPEG, ...)
+    static constexpr int kMaxLowres = 3;    // 1/8 of each dimension
+    int chooseLowres(const AVCodec* codec);
+    // Decoder outputs the renderer can take as-is (no swscale pass)
+    bool directIYUV = false;
+    bool directNV12 = false;
     int videoStreamIndex = -1;//
     int width = 0, height = 0;
     bool frameReady;
-    bool isPaused = false;
+    std::atomic<bool> isPaused{false};
     double currentPts = 0.0;
     float seekTargetTime = -1.0f;
     //audio
     int audioStreamIndex = -1;
     AVCodecContext* AudioCodecCtx = nullptr;
     SwrContext* swrCtx = nullptr;
+    // Negotiated device format that every decoded frame is converted to
+    AVSampleFormat deviceSampleFmt = AV_SAMPLE_FMT_FLT;
+    AVChannelLayout deviceLayout = {};
+    int deviceBytesPerFrame = 0;   // bytes per sample across all channels
+    // Input parameters swrCtx was built for; a change rebuilds it
+    AVSampleFormat swrInFmt = AV_SAMPLE_FMT_NONE;
+    int swrInRate = 0;
+    AVChannelLayout swrInLayout = {};
+    std::vector<uint8_t> resampleBuffer;  // grows to the largest frame seen, reused afterwards
 
     SDL_AudioDeviceID audioDevice = 0;
     SDL_AudioSpec audioSpec;
     SDL_AudioSpec wantSpec;
     AVFrame* audioFrame = nullptr;
     int channels2 = 1;
+    int audioBytesPerSec = 0;
+    int audioSerial = -1;
+
+    // Demux thread: owns fmtCtx reads and fills the per-stream packet queues
+    // (defaults for Options; the limits in effect come from options at load time)
+    static constexpr size_t kVideoQueueBytes = 64 * 1024 * 1024;
+    static constexpr size_t kAudioQueueBytes = 4 * 1024 * 1024;
+    static constexpr double kQueueSeconds = 5.0;
+    PacketQueue videoQueue{kVideoQueueBytes, kQueueSeconds};
+    PacketQueue audioQueue{kAudioQueueBytes, kQueueSeconds};
+    std::thread demuxThread;
+    std::mutex demuxMutex;
+    std::condition_variable demuxCond;
+    std::atomic<bool> demuxAbort{false};
+    std::atomic<bool> demuxEof{false};
+    bool seekRequested = false;      // guarded by demuxMutex
+    bool seekInFlight = false;       // demuxer took the request but has not flushed yet
+    double requestedSeekTime = 0.0;  // guarded by demuxMutex
+    bool requestedKeyframeOnly = false; // scrub preview: show the keyframe, skip the catch-up
+    int seekSerial = -1;             // queue serial produced by the last seek (guarded by demuxMutex)
+    double seekSerialTarget = -1.0;  // target time belonging to seekSerial
+    bool seekSerialKeyframeOnly = false;
+    // Every request gets a generation; while the newest one has not been flushed into the
+    // queues, whatever the decoders are working on is already obsolete and gets abandoned
+    std::atomic<int> seekGeneration{0};          // bumped by requestSeek
+    std::atomic<int> servicedSeekGeneration{0};  // generation of the last seek the demuxer flushed
+    std::atomic<int> seeksCoalesced{0};          // requests replaced before the demuxer took them
+    std::atomic<int> seeksAbandoned{0};          // catch-up decodes cut short by a newer request
+    int videoSerial = -1;            // serial of the last video packet fed to the decoder
+
+    // Seeks go straight to the keyframe before the target when the index knows it
+    KeyframeIndex keyframeIndex;
+    std::atomic<double> seekKeyframeGap{0.0};   // target minus the keyframe the last seek landed on
+    std::atomic<int> seekCatchupFrames{0};      // pictures decoded and discarded to reach the target
+    std::atomic<double> seekCatchupMs{0.0};     // from the decoder seeing the seek to the target picture
+    double catchupStart = 0.0;                  // video decode thread only
+    int catchupFrames = 0;
+    bool seekToKeyframe(double seekTime);
+
+    void demuxLoop();
+    void wakeDemuxer();
+    void startDemuxer();
+    void stopDemuxer();
+    void requestSeek(double time, bool keyframeOnly = false);
+    bool seekPending();
+    bool newerSeekPending() const;
+    double seekTargetForSerial(int serial, bool* keyframeOnly = nullptr);
+    float clampSeekTime(float time);
+
+    // Scrub mode (timeline drag): keyframe-only seeks, at most one waiting for its picture.
+    // Render thread only, apart from the flag the decoders read.
+    static constexpr double kScrubRetry = 0.25; // stop waiting for a scrub picture after this long
+    std::atomic<bool> scrubbing{false};
+    double scrubTarget = -1.0;      // latest position asked for by the slider
+    double scrubIssued = -1.0;      // position of the last keyframe seek sent to the demuxer
+    double scrubIssuedAt = 0.0;
+    bool scrubAwaitingFrame = false;
+    void pumpScrub();
+
+    // Audio decode thread fills audioRing; the SDL audio callback drains it and applies volume
+    static constexpr double kAudioRingSeconds = 0.5;
+    AudioRingBuffer audioRing;
+    std::thread audioDecodeThread;
+    std::atomic<bool> audioDecodeAbort{false};
+    std::atomic<int> ringSerial{-1};        // packet serial the ring contents were decoded from
+    float appliedGain = 2.0f;               // gain at the end of the last callback buffer (audio callback only)
+    // Where ring bytes sit on the media timeline. Every (re)start and every rate change opens a
+    // new anchor, so sound already buffered at the old rate is still timed correctly.
+    struct RingAnchor {
+        uint64_t byte;  // ring write position the anchor starts at
+        double pts;     // media time of that byte
+        double rate;    // media seconds per second of ring audio
+    };
+    std::mutex ringAnchorMutex;             // the audio callback only ever try_locks it
+    std::deque<RingAnchor> ringAnchors;
+    TimeStretcher stretcher;                // audio decode thread only
+    void anchorRing(double pts, double rate);
+
+    void audioDecodeLoop();
+    void startAudioDecoder();
+    void stopAudioDecoder();
+    bool writeAudio(const uint8_t* data, size_t size, int serial);
+    bool resampleAudio(const AVFrame* in, const uint8_t** out, size_t* outSize);
+    static void audioCallback(void* userdata, Uint8* stream, int len);
+    void fillAudio(Uint8* stream, int len);
+
+    // Video decode thread: decodes and converts pictures into frameQueue for the render thread
+    static constexpr int kFrameQueueDepth = 4;
+    FrameQueue frameQueue{kFrameQueueDepth};
+    std::thread videoDecodeThread;
+    std::atomic<bool> videoDecodeAbort{false};
+    static constexpr double kSeekSlotSlack = 0.001;  // a slot ending this close to a seek target does not cover it
+
+    // Short backward seeks replay recently decoded pictures from RAM
+    static constexpr size_t kFrameCacheBytes = 512 * 1024 * 1024;
+    static constexpr double kMinCachedRun = 0.5;       // shorter spans are not worth a replay
+    static constexpr double kReplayDecodeAhead = 1.0;  // decoder lead over a running replay (s)
+    FrameCache frameCache{kFrameCacheBytes};
+    std::atomic<int> cacheHits{0};
+    std::atomic<int> framesFromCache{0};
+
+    enum class QueueResult { Queued, Dropped, Stale };
+
+    void videoDecodeLoop();
+    void startVideoDecoder();
+    void stopVideoDecoder();
+    QueueResult queuePicture(AVFrame* picture, double pts, double duration, int serial);
+    bool canUploadDirectly(const AVFrame* src);
+    bool convertFrame(const AVFrame* src, AVFrame* dst, FrameScaler* frameScaler);
+    bool ensureTexture(int pixFmt, int w, int h);
+    void updateTexture(const AVFrame* picture);
+    void dropStaleFrames();
+    bool uploadNextFrame();
+
+    // Frame stepping while paused (render thread). Steps are served from frameCache when the
+    // neighbouring picture is there; otherwise forward waits for the decoder and backward
+    // re-decodes the GOP before the current picture (which fills the cache for the next steps).
+    int pendingStep = 0;            // +1/-1 until its picture is on screen
+    double stepRequestedAt = 0.0;
+    bool stepSeeked = false;        // backward step is waiting for its re-decode
+    bool stepLeftQueue = false;     // position came from the cache: frameQueue no longer follows it
+    AVFrame* stepFrame = nullptr;   // picture fetched from the cache
+    AVFrame* renderRgb = nullptr;   // RGB24 conversion of native pictures the render thread uploads
+    void serveStep();
+    void presentStep(const AVFrame* picture, double pts, double duration);
+    void uploadNativePicture(const AVFrame* picture);
+
+    // Reverse playback: reverseDecoder walks the file backwards on its own thread and the
+    // render thread presents its pictures against a clock that runs towards the start
+    static constexpr size_t kReverseBufferBytes = 512 * 1024 * 1024;
+    ReverseDecoder reverseDecoder;
+    std::string loadedPath;
+    bool reverse = false;
+    Clock reverseClock;             // wall time played backwards since reverseOrigin
+    double reverseOrigin = 0.0;     // media time at which reverseClock read 0
+    bool reverseAnchored = false;   // the first reverse picture sets reverseOrigin
+    void startReverse(double from);
+    bool uploadReverseFrame();
+
+    // Presentation clock: follows the audio actually handed to SDL, free-runs on the system
+    // clock when there is no audio (or the audio queue ran dry)
+    Clock masterClock;
+    // Playhead of the audio device, published by the callback without taking a lock: the
+    // sequence number is odd while the fields are being written, readers retry until they see
+    // the same even value before and after reading them
+    std::atomic<unsigned> audioClockSeq{0};
+    std::atomic<double> audioClockPts{0.0};       // media time playing at audioClockUpdatedAt
+    std::atomic<double> audioClockRate{1.0};      // media seconds per second of device audio
+    std::atomic<double> audioClockUpdatedAt{0.0};
+    std::atomic<int> audioClockSerial{-1};  // serial of the audio the callback last timed
+    double readAudioClock() const;
+    static constexpr double kAudioClockStale = 0.25; // no callback data for this long: underrun
+    double audioSeekTarget = -1.0;          // audio before this time is dropped after a seek
+    bool audioDrivesClock = false;
+    std::atomic<bool> clockNeedsAnchor{true}; // re-anchor the system clock on the next picture
+    double frameDuration = 1.0 / 25.0;      // nominal picture duration from the stream frame rate
+    double displayedUntil = 0.0;            // when the picture on screen stops being current
+    bool haveFrame = false;
+    void resetClock();
+    // Presentation timing from the render loop (render thread only): pictures are chosen for
+    // the vsync they will appear on, rounded to the nearest one
+    double presentLead = 0.0;               // seconds until the frame being drawn reaches the screen
+    double vsyncInterval = 0.0;             // display refresh interval (0: unknown, no rounding)
+
+    static constexpr double kMaxFrameDelay = 2.0; // larger gaps are timestamp jumps, not waits
+
+    // Load shedding on the video decode thread: late pictures are dropped before conversion,
+    // and sustained lag raises the decoder skip level (0: none, 1: non-ref frames, 2: + loop filter)
+    static constexpr int kSkipWindow = 30;        // pictures per skip-level evaluation
+    static constexpr int kMaxSkipLevel = 2;
+    static constexpr int kMaxConsecutiveDrops = 5; // always let a picture through eventually
+    int consecutiveLateDrops = 0;
+    int skipWindowFrames = 0;
+    int skipWindowLate = 0;
+    int skipWindowHeadroom = 0;
+    std::atomic<int> skipLevel{0};
+    std::atomic<int> lateFramesDropped{0};
+    std::atomic<int> skipLevelChanges{0};
+
+    // Playback rate: audio keeps its pitch through the stretcher, video skips what it cannot show
+    static constexpr float kMinPlaybackRate = 0.25f;
+    static constexpr float kMaxPlaybackRate = 4.0f;
+    static constexpr double kMaxShownFps = 60.0;   // above this many pictures/s, skip non-ref frames
+    std::atomic<float> playbackRate{1.0f};
+    std::atomic<bool> rateSkipsNonRef{false};      // set by the video decode thread
+    // Video decode thread: a skip level was in effect, so pictures up to the next keyframe may
+    // predict from degraded (unfiltered) references and must not go into the frame cache
+    bool cacheAwaitsKeyframe = false;
+
+    bool isFrameLate(double pts);
+    void updateSkipPolicy(double pts, bool late);
+    void applySkipLevel(int level);
 
     
 // For video resampler
-struct SwsContext* swsCtxVideo = nullptr;
+FrameScaler renderScaler;   // render thread (cached, stepped and reverse pictures)
 
 
 
 
     
 public:
+    // Presentation/sync counters for the stats overlay
+    struct PlaybackStats {
+        int framesPresented = 0;
+        int framesDropped = 0;     // late pictures skipped to catch up with the clock
+        int framesRepeated = 0;    // frame slots where no new picture was ready in time
+        double drift = 0.0;        // pts of the last presented picture minus the master clock (s)
+        double avgDrift = 0.0;     // smoothed absolute drift (s)
+        double maxDrift = 0.0;     // largest absolute drift seen (s)
+        bool audioMaster = false;  // clock currently follows the audio device
+        int lateDropped = 0;       // pictures dropped by the decoder before conversion
+        int skipLevel = 0;         // 0: full decode, 1: skip non-ref frames, 2: also skip loop filter
+        int skipLevelChanges = 0;  // escalations plus back-offs since load
+        const char* videoCodec = "";
+        int decoderThreads = 0;        // thread_count the video decoder actually runs with
+        const char* decoderThreadType = "none";  // active threading: frame, slice or none
+        const char* keyframeIndex = "none";      // container, scan, scanning or none
+        int keyframes = 0;
+        double lastSeekKeyframeGap = 0.0;  // seconds between the keyframe and the seek target
+        int lastSeekCatchupFrames = 0;     // pictures decoded only to reach the target
+        double lastSeekCatchupMs = 0.0;
+        int seeksCoalesced = 0;            // superseded before they started
+        int seeksAbandoned = 0;            // catch-up decodes dropped for a newer target
+        int cacheHits = 0;                 // seeks served from the decoded frame cache
+        int framesFromCache = 0;           // pictures replayed instead of decoded
+        int cachedFrames = 0;
+        double cacheMB = 0.0;
+        int steps = 0;                     // single-frame steps taken
+        double lastStepMs = 0.0;           // from the step request to its picture being uploaded
+        bool reverse = false;
+        double reverseBufferMB = 0.0;      // decoded pictures waiting to be shown backwards
+        int reverseRedecodes = 0;          // GOPs decoded more than once because they did not fit
+        bool mmapIO = false;               // main demuxer reads through MmapIO
+        uint64_t ioReads = 0;
+        uint64_t ioSeeks = 0;
+        double ioMB = 0.0;
+        const char* prefetch = "off";      // read-ahead backend: io_uring, pread or off
+        uint64_t prefetchReads = 0;
+        uint64_t prefetchStalls = 0;       // demuxer reads that waited for storage
+        double prefetchStallMs = 0.0;
+        uint64_t prefetchRetargets = 0;    // seeks that moved the read-ahead window
+        const char* streamInfo = "probe";  // where the stream parameters came from: probe, fast probe, cache
+        double openMs = 0.0;               // open + stream info
+        double firstFrameMs = 0.0;         // load() to the first picture on screen (0: not yet)
+        float playbackRate = 1.0f;
+        bool rateSkip = false;             // non-ref pictures are not decoded at this rate
+        int outputWidth = 0;               // size pictures are uploaded at (scale-on-decode)
+        int outputHeight = 0;
+        const char* scaler = "bilinear";
+        int scaleThreads = 0;              // slice threads of the decode thread's converter (0: unused yet)
+        int lowres = 0;                    // decoder runs at 1/(1 << lowres) of each dimension
+        int decodeWidth = 0;               // size the decoder outputs
+        int decodeHeight = 0;
+    };
+
+    // Tunables; set before load(), they apply to the next file opened
+    struct Options {
+        DecoderThreadingOptions videoThreading;
+        size_t videoQueueBytes = kVideoQueueBytes;
+        size_t audioQueueBytes = kAudioQueueBytes;
+        double queueSeconds = kQueueSeconds;
+        size_t frameCacheBytes = kFrameCacheBytes;  // decoded picture cache budget, 0 disables it
+        size_t reverseBufferBytes = kReverseBufferBytes; // reverse playback picture budget
+        InputOptions input;          // I/O path and probing (shared with vcplayer_bench)
+        bool scaleToDisplay = true;  // convert pictures at the window size instead of full resolution
+        // 0: full resolution, 1-3: 1/2, 1/4, 1/8, -1: from the window size at load. Automatic mode
+        // suits small or preview windows: the level stays fixed until the next load, so a window
+        // enlarged afterwards (fullscreen) shows an upscaled picture until the file is reopened
+        int lowres = 0;
+        int scaleThreads = 0;        // swscale slice threads per conversion, 0: from cores and picture size
+    };
+
+    ~VideoPlayer();
     bool load(const std::string& filepath, SDL_Renderer* renderer);
     void renderFrame(SDL_Renderer* renderer);
-    void decodeNextFrame();
+    void setPresentTiming(double lead, double refreshInterval); // before renderFrame, see FramePacer
+    double getFrameInterval();      // wall seconds per picture at the current speed, 0 when not playing
+    bool hasNewPicture() const;     // the last renderFrame put up a new picture
     void cleanup();
     void togglePause();
     bool getPauseState();
+    // Single-frame steps; they pause playback first
+    void stepForward();
+    void stepBackward();
+    // Play backwards from the current position (video only, audio is muted)
+    void setReverse(bool enable);
+    bool isReverse() const;
+    // Playback speed, 0.25x to 4x; audio is time-stretched so the pitch stays the same
+    void setPlaybackRate(float rate);
+    float getPlaybackRate() const;
+    // swscale filter for resizing: speed vs quality, takes effect with the next picture
+    void setScaleAlgorithm(ScaleAlgorithm algorithm);
+    ScaleAlgorithm getScaleAlgorithm() const;
 
     //seeking
     void seek(float seconds);
@@ -68,6 +398,30 @@ public:
     float getDuration();
     void seekTo(float time); //used by timeline slider
 
+    // Timeline dragging: fast keyframe previews while the slider is held, one accurate seek on release
+    void beginScrub();
+    void scrubTo(float time);
+    void endScrub(float time);
+    void cancelScrub();   // released without moving: nothing to seek
+    bool isScrubbing() const;
+
     void changeVolume(float diffVolume, bool setDefault = false);
-    float volume = 2.0f; 
+    std::atomic<float> volume{2.0f}; // read by the audio callback
+
+    //sync
+    double getMasterClock();
+    double getTimeUntilNextFrame(); // seconds until the next picture is due, <0 when nothing is pending
+    bool needsRefresh();            // false when paused with no seek/step/scrub waiting for its picture
+    PlaybackStats getStats();
+
+    void setOptions(const Options& newOptions);
+    const Options& getOptions() const;
+    // Only the I/O path and probing (safe while playing): the next file opened uses them
+    void setInputOptions(const InputOptions& input);
+    // Options::lowres alone, same rules: applies to the next file opened
+    void setLowres(int level);
+
+private:
+    PlaybackStats stats;
+    Options options;
 };